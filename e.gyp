@@ -27,16 +27,27 @@
       'src/js_curses.cc',
       'src/js_curses_window.cc',
       'src/js_errno.cc',
+      'src/js_keymap.cc',
       'src/js_signal.cc',
       'src/js_sys.cc',
+      'src/key_record.cc',
       'src/keycode.cc',
+      'src/keymap.cc',
+      'src/latency.cc',
       'src/line.cc',
+      'src/line_tree.cc',
       'src/logging.cc',
       'src/mmap.cc',
       'src/module.cc',
       'src/module_decl.cc',
       'src/state.cc',
+      'src/status_bar.cc',
+      'src/term_output.cc',
       'src/timer.cc',
+      'src/utf8.cc',
+      'src/viewport.cc',
+      'src/watchdog.cc',
+      'src/wcwidth.cc',
     ],
     'conditions': [
       ['OS=="freebsd"', {
@@ -88,5 +99,19 @@
         '-lboost_unit_test_framework'
       ],
     },
+    {
+      'target_name': 'term_bench',
+      'cflags': ['-O2'],
+      'sources': [
+        'src/bench/term_bench.cc',
+      ],
+    },
+    {
+      'target_name': 'utf8_bench',
+      'cflags': ['-O2'],
+      'sources': [
+        'src/bench/utf8_bench.cc',
+      ],
+    },
   ],
 }
@@ -2,10 +2,12 @@
 
 var curses = require("curses");
 var errno = require("errno");
+var keymap = require("keymap");
 var signal = require("signal");
 var sys = require("sys");
 
-var EventListener = require("js/event_listener.js").EventListener;
+var eventListener = require("js/event_listener.js");
+var EventListener = eventListener.EventListener;
 var colors = require("js/colors.js");
 
 // You can easily override most of these attributes in your ~/.e.js file (e.g.
@@ -23,6 +25,9 @@ var core = {
   parser: require("js/parser.js").parser,
   listeners: {},
   windows: {},
+  viewport: null, // draws world.buffer into windows.buffer
+  statusBar: null, // draws the fields of windows.status
+  keyBatching: false, // see core.enableKeyBatching()
 };
 
 /**
@@ -84,6 +89,7 @@ core.addFunction("logTrace", function () {
 
 core.addFunction("switchMode", function (newMode) {
   core.curmode = newMode;
+  keymap.setMode(newMode);
   core.drawStatus();
 });
 
@@ -91,6 +97,15 @@ core.addFunction("updateAllWindows", function (doupdate) {
   if (doupdate === undefined) {
     doupdate = true;
   }
+  // redraw the parts of the buffer window that are out of date
+  if (core.viewport !== null) {
+    core.viewport.repaint();
+  }
+  if (core.statusBar !== null) {
+    core.statusBar.repaint();
+  }
+  var bytesWritten = curses.bytesWritten();
+
   var w;
   for (w in core.windows) {
     if (core.windows.hasOwnProperty(w) && core.windows[w].noutrefresh) {
@@ -103,6 +118,61 @@ core.addFunction("updateAllWindows", function (doupdate) {
 
   // do the update
   curses.doupdate();
+  if (debug && core.viewport !== null) {
+    log("painted " + core.viewport.rowsPainted + " rows, wrote " +
+        (curses.bytesWritten() - bytesWritten) + " bytes");
+  }
+});
+
+/**
+ * Starts (or stops) profiling the time spent in event listeners, both those
+ * added with world.addEventListener() and those added to an EventListener
+ * (e.g. with core.addKeypressListener). Starting clears the last profile.
+ *
+ * @param {boolean} enabled true to start profiling, false to stop
+ */
+core.addFunction("setListenerProfiling", function (enabled) {
+  world.setListenerProfiling(enabled);
+  eventListener.setProfiling(enabled);
+});
+
+/**
+ * Gets the listener profile, as an array of objects with the properties name,
+ * calls, total, mean and max (the times are in microseconds, and include time
+ * spent in the listeners a listener dispatches to), sorted from the largest
+ * value of sortKey to the smallest.
+ *
+ * @param {string} [sortKey] "calls", "total" (the default), "mean" or "max"
+ */
+core.addFunction("listenerProfile", function (sortKey) {
+  if (["calls", "total", "mean", "max"].indexOf(sortKey) === -1) {
+    sortKey = "total";
+  }
+  var merged = {};
+  var add = function (entries) {
+    for (var i = 0; i < entries.length; i++) {
+      var e = entries[i];
+      var m = merged[e.name];
+      if (m === undefined) {
+        m = merged[e.name] = {name: e.name, calls: 0, total: 0, max: 0};
+      }
+      m.calls += e.calls;
+      m.total += e.total;
+      m.max = Math.max(m.max, e.max);
+    }
+  };
+  add(world.listenerProfile());
+  add(eventListener.getProfile());
+
+  var result = [];
+  for (var name in merged) {
+    if (merged.hasOwnProperty(name)) {
+      merged[name].mean = merged[name].total / merged[name].calls;
+      result.push(merged[name]);
+    }
+  }
+  result.sort(function (a, b) { return b[sortKey] - a[sortKey]; });
+  return result;
 });
 
 // Update the screen, and then sleep for some amount of time (by default one
@@ -2,6 +2,35 @@
 //
 // An implementation of the event listener interface.
 
+var sys = require("sys");
+
+// The calls to and time spent in (in microseconds) each listener while
+// profiling, keyed by name
+var profiling = false;
+var profile = {};
+
+var listenerName = function (callback, name) {
+  return callback.displayName || callback.name ||
+    "(anonymous " + name + " listener)";
+};
+
+var callProfiled = function (func, that, name, args) {
+  var start = sys.monotonicTime();
+  try {
+    func.apply(that, args);
+  } finally {
+    var elapsed = sys.monotonicTime() - start;
+    var key = listenerName(func, name);
+    var stats = profile[key];
+    if (stats === undefined) {
+      stats = profile[key] = {name: key, calls: 0, total: 0, max: 0};
+    }
+    stats.calls++;
+    stats.total += elapsed;
+    stats.max = Math.max(stats.max, elapsed);
+  }
+};
+
 var addListener = function (callbacks, name, callback) {
   callbacks[name] = callbacks[name] || [];
   callbacks[name].push(callback);
@@ -23,9 +52,12 @@ var dispatch = function (obj, name, args) {
   for (var i = 0; i < list.length; i++) {
     var callback = list[i];
     if (callback.handleEvent) {
-      callback.handleEvent.apply(this, args);
-    } else {
+      callback = callback.handleEvent;
+    }
+    if (!profiling) {
       callback.apply(this, args);
+    } else {
+      callProfiled(callback, this, name, args);
     }
   }
 };
@@ -69,4 +101,27 @@ EventListener.prototype.dispatch = function (eventName) {
   dispatch(this.bubbles, eventName, args);
 };
 
+// Start (or stop) profiling the listeners of every EventListener; starting
+// clears the previous profile.
+var setProfiling = function (enabled) {
+  if (enabled && !profiling) {
+    profile = {};
+  }
+  profiling = !!enabled;
+};
+
+// The profile recorded since profiling was started, as an array of objects
+// with the properties name, calls, total and max.
+var getProfile = function () {
+  var result = [];
+  for (var key in profile) {
+    if (profile.hasOwnProperty(key)) {
+      result.push(profile[key]);
+    }
+  }
+  return result;
+};
+
 exports.EventListener = EventListener;
+exports.getProfile = getProfile;
+exports.setProfiling = setProfiling;
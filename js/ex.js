@@ -1,5 +1,40 @@
+var exProfile = function (action, sortKey) {
+  switch (action) {
+  case "start":
+  case "on":
+    core.setListenerProfiling(true);
+    core.notificationText.set("profiling listeners");
+    break;
+  case "stop":
+  case "off":
+    core.setListenerProfiling(false);
+    core.notificationText.set("stopped profiling listeners");
+    break;
+  case "report":
+    var profile = core.listenerProfile(sortKey);
+    var fmt = function (us) { return (us / 1000).toFixed(3) + "ms"; };
+    log("listener profile (by " + (sortKey || "total") + "):");
+    for (var i = 0; i < profile.length; i++) {
+      var p = profile[i];
+      log("  " + p.name + ": calls=" + p.calls + " total=" + fmt(p.total) +
+          " mean=" + fmt(p.mean) + " max=" + fmt(p.max));
+    }
+    if (profile.length > 0) {
+      core.notificationText.set("top listener: " + profile[0].name + " (" +
+                                fmt(profile[0].total) + " total), see log");
+    } else {
+      core.notificationText.set("no listener profile (try :profile start)");
+    }
+    break;
+  default:
+    core.errorText.set("usage: :profile start|stop|report [sort key]");
+    break;
+  }
+};
+
 core.addKeypressListener("ex", function (event) {
   if (event.getCode() == 13) {
+    var match;
     switch (core.exBuffer) {
     case "wq":
     case "wqa":
@@ -10,6 +45,25 @@ core.addKeypressListener("ex", function (event) {
     case "qa!":
       world.stopLoop();
       break;
+    default:
+      // :profile starts or stops profiling listeners; ":profile report"
+      // logs the profile, optionally sorted by calls, total, mean or max
+      match = /^prof(?:ile)?(?:\s+(\w+))?(?:\s+(\w+))?$/.exec(core.exBuffer);
+      if (match) {
+        exProfile(match[1] || "report", match[2]);
+        break;
+      }
+      // :goto N moves to byte N of the file (counting from 1)
+      match = /^go(?:to?)?\s*(\d*)$/.exec(core.exBuffer);
+      if (match) {
+        var offset = match[1] ? parseInt(match[1], 10) - 1 : 0;
+        core.line = world.buffer.lineOfOffset(offset > 0 ? offset : 0);
+        // the column is only exact if the line is ASCII
+        var lineOffset = offset - world.buffer.offsetOfLine(core.line);
+        core.column = Math.max(0, Math.min(
+          lineOffset, world.buffer.getLine(core.line).length));
+      }
+      break;
     }
     core.exBuffer = "";
     core.switchMode('command');
@@ -26,22 +26,10 @@ core.addKeypressListener("insert", function (event) {
       // chop the end of the line, so that it can be added to the following line
       chopped = line.value().substring(core.column, line.length);
       line.chop(core.column);
-      core.windows.buffer.clrtoeol();
     }
-    // scroll the region below the cursor one line down
-    core.scrollRegion(-1, core.windows.buffer.getcury() + 2);
     world.buffer.addLine(++core.line, chopped);  // add the new line, with the chopped contents
     core.column = 0;
-
-    // need to move before drawing the new line
     core.move();
-
-    if (chopped) {
-      core.windows.buffer.addstr(chopped);
-      core.windows.buffer.clrtoeol();
-    } else {
-      core.windows.buffer.clrtoeol();
-    }
     break;
   case 19: // Ctrl-S
     if (!world.buffer.persist(world.buffer.getFile())) {
@@ -53,11 +41,6 @@ core.addKeypressListener("insert", function (event) {
   default:
     var curline = world.buffer.getLine(core.line);
     curline.insert(core.column, wch);
-    if (core.column < curline.length - 1) {
-      core.windows.buffer.insch(wch);
-    } else {
-      core.windows.buffer.addstr(wch);
-    }
     core.column += wch.length;
     break;
   }
@@ -68,8 +51,6 @@ core.addKeypressListener("insert", function (event) {
       log("backspace, core.line = " + core.line);
       if (core.column > 0) {
         var curline = world.buffer.getLine(core.line);
-        core.windows.buffer.mvdelch(cury, curx - 1);
-        curses.stdscr.move(cury + 1, curx - 1);
         core.column--;
         curline.erase(core.column, 1);
       } else if (core.line > 0) {
@@ -83,18 +64,7 @@ core.addKeypressListener("insert", function (event) {
         if (contents) {
           curline.append(contents);
         }
-
-        // clear the current line
-        core.moveAbsolute(cury, 0);
-        core.windows.buffer.clrtoeol();
-        // scroll up
-        core.scrollRegion(1, core.windows.buffer.getcury(), core.windows.buffer.getmaxy());
-        // redraw the previous line
-        core.moveAbsolute(cury - 1, core.column);
-        if (contents) {
-          core.windows.buffer.addstr(contents)
-          core.moveAbsolute(cury - 1, core.column);
-        }
+        core.move();
       }
       break;
     case "KEY_DOWN":
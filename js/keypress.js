@@ -14,27 +14,64 @@
 // emulating vi's command mode, etc. There can be arbitrarily many modes, and
 // the current mode is set by the value of core.curmode.
 //
-// When a keypress happens, any handlers that have registered themself for the
-// mode using core.addKeypressListener will be called.
+// Keys (or sequences of keys, like "gg") can be bound in a mode with
+// core.bindKey. Bindings are matched natively by the keymap module, so a bound
+// key only costs a call to the function it's bound to.
+//
+// When a keypress happens that isn't bound in the current mode, any handlers
+// that have registered themself for the mode using core.addKeypressListener
+// will be called.
+core.bindKey = function (mode, keys, handler) {
+  keymap.bind(mode, keys, handler);
+};
+
+// the number of keypress listeners added for each mode
+var listenerCounts = {};
+
 core.addKeypressListener = function (mode, handler) {
   core.listeners[mode] = core.listeners[mode] || new EventListener();
   core.listeners[mode].addEventListener("keypress", handler);
+  listenerCounts[mode] = (listenerCounts[mode] || 0) + 1;
 };
 
+keymap.setMode(core.curmode);
+
 // This method checks for Ctrl-C. We add it as its own top level handler to
 // prevent the editor from getting "stuck" due other JavaScript errors (IOW, no
 // matter what else happens you'll be able to exit using Ctrl-C).
-world.addEventListener("keypress", function (event) {
+core.addFunction("checkInterrupt", function (event) {
   if (event.getCode() == 3) {
     log("Caught Ctrl-C, stopping the main loop");
     world.stopLoop();
   }
 });
+world.addEventListener("keypress", core.checkInterrupt);
+
+// The keymap only notices that a pending sequence has timed out when the next
+// key comes in, so a sequence that's bound itself (like "g" when "gg" is also
+// bound) is flushed by a timer if no key comes in before the timeout.
+var flushTimer = null;
+var watchPending = function (result) {
+  if (flushTimer !== null) {
+    clearTimeout(flushTimer);
+    flushTimer = null;
+  }
+  var timeout = keymap.getTimeout();
+  if (result === keymap.PENDING && timeout > 0) {
+    flushTimer = setTimeout(function () {
+      flushTimer = null;
+      if (keymap.flush()) {
+        core.drawStatus();
+        core.updateAllWindows();
+      }
+    }, timeout);
+  }
+};
 
 // Core routine called on each keypress; this essentially just dispatches to
 // listeners registered by core.addKeypressListener (see the comments at that
 // function for the details).
-world.addEventListener("keypress", function (event) {
+core.addFunction("handleKeypress", function (event) {
   var code = event.getCode();
   core.errorText.clear();
   core.warningText.clear();
@@ -61,8 +98,14 @@ world.addEventListener("keypress", function (event) {
     break;
   }
   if (!setEscape) {
-    var listener = core.listeners[core.curmode] || new EventListener();
-    listener.dispatch("keypress", event);
+    var result = keymap.dispatch(event);
+    watchPending(result);
+    if (result === keymap.UNBOUND) {
+      var listener = core.listeners[core.curmode];
+      if (listener !== undefined) {
+        listener.dispatch("keypress", event);
+      }
+    }
     core.inEscape = false;
   }
 
@@ -79,11 +122,62 @@ world.addEventListener("keypress", function (event) {
     log(">>>>>>> END >>>>>>>");
   }
 });
+world.addEventListener("keypress", core.handleKeypress);
+
+// Can a key be inserted as part of a run of typed text? Only if inserting it
+// is all that handling it would do: it's an ordinary character, it doesn't
+// continue or start a sequence bound in insert mode (like "jk"), and the only
+// insert mode listener is the one in insert_mode.js.
+var isRunKey = function (event) {
+  var code = event.getCode();
+  return (!event.isKeypad() && code >= 32 && code != 127 &&
+          keymap.pendingLength() === 0 && !keymap.startsSequence(event) &&
+          listenerCounts.insert === 1);
+};
+
+// Keys can also be handled in batches, with a "keypress_batch" event for all
+// of the keys read at once (e.g. when typing quickly, or with key repeat),
+// rather than a "keypress" event per key. Once there's a listener for
+// keypress_batch events no keypress events are sent, so this handles each key
+// the same way the keypress listeners above do, except that in insert mode a
+// run of ordinary characters is inserted into the line all at once (as long
+// as nothing else would see them; see isRunKey).
+core.addFunction("handleKeypressBatch", function (keys) {
+  var i = 0;
+  while (i < keys.length) {
+    if (core.curmode == "insert" && !core.inEscape && isRunKey(keys[i])) {
+      var run = "";
+      while (i < keys.length && isRunKey(keys[i])) {
+        run += keys[i++].getChar();
+      }
+      core.errorText.clear();
+      core.warningText.clear();
+      world.buffer.getLine(core.line).insert(core.column, run);
+      core.column += run.length;
+      core.drawStatus();
+      continue;
+    }
+    core.checkInterrupt(keys[i]);
+    core.handleKeypress(keys[i]);
+    i++;
+  }
+});
+
+// Switch to handling keys in batches (see above); this can be called from
+// ~/.e.js, and can't be undone.
+core.addFunction("enableKeyBatching", function () {
+  if (!core.keyBatching) {
+    core.keyBatching = true;
+    world.addEventListener("keypress_batch", core.handleKeypressBatch);
+  }
+});
 
 // This is the callback that specifically causes curses to flush all of its
 // drawing operations. It *must* be called after any functions that may do
-// drawing operations, which is why it has its own special event. In general,
-// it's not recommended that other functions register to listen to the
+// drawing operations, which is why it has its own special event. The event is
+// dispatched once per burst of input (i.e. once there are no more keys waiting
+// to be handled, or the --frame-deadline has passed), not once per key. In
+// general, it's not recommended that other functions register to listen to the
 // "after_keypress" event, and if they do they must not do any drawing
 // operations.
 //
@@ -94,5 +188,16 @@ world.addEventListener("after_keypress", function (e) {
   core.updateAllWindows();
 });
 
+// Text pasted into the terminal (with bracketed paste) arrives as a single
+// "paste" event, rather than as a keypress per character. The whole paste is
+// inserted into the buffer at once, regardless of the current mode; the screen
+// is updated by the after_keypress event that follows.
+world.addEventListener("paste", function (text) {
+  var end = world.buffer.insertText(core.line, core.column, text);
+  core.line = end.line;
+  core.column = end.column;
+  core.drawStatus();
+});
+
 require("js/insert_mode.js");
 require("js/vi.js");
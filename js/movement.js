@@ -26,7 +26,6 @@ core.addFunction("scrollRegion", function (lines, top, bot) {
   var curx = core.windows.buffer.getcurx();
   var cury = core.windows.buffer.getcury();
   var maxy = core.windows.buffer.getmaxy();
-  var maxAllowed = world.buffer.length - 1;
 
   if (top === undefined) {
     top = 0;
@@ -45,22 +44,13 @@ core.addFunction("scrollRegion", function (lines, top, bot) {
     return lines;
   }
 
-  var newLine, newLinePos;
-  var lineDelta = lastline - cury;
-  log("line delta is " + lineDelta);
-  var tildePair = colors.getColorPair(curses.COLOR_BLUE, -1);
-  for (var i = top; i <= bot; i++) {
-    newLinePos = i + lineDelta + lines;
-    if (newLinePos > maxAllowed) {
-      core.windows.buffer.attron(tildePair);
-      core.windows.buffer.mvaddstr(i, 0, "~");
-      core.windows.buffer.clrtoeol();
-      core.windows.buffer.attroff(tildePair);
-    } else {
-      newLine = world.buffer.getLine(i + lineDelta + lines).value();
-      core.windows.buffer.mvaddstr(i, 0, newLine);
-      core.windows.buffer.clrtoeol();
-    }
+  // The viewport redraws the scrolled rows on the next screen update. If only
+  // part of the window was scrolled the lines in it have already changed (i.e.
+  // lines were inserted or deleted), so the viewport knows to redraw them.
+  if (top === 0 && bot >= maxy - 1) {
+    core.viewport.top = core.windowTop() + lines;
+  } else {
+    core.viewport.damage(top, bot);
   }
   core.windows.buffer.move(cury, curx);
   //core.move();
@@ -103,9 +93,15 @@ core.addFunction("move", function (line, col) {
   var maxy = core.windows.buffer.getmaxy();
   var maxx = core.windows.buffer.getmaxx();
 
-  // Restrict the column (to prevent scrolling off the end of the screen).
-  if (col > maxx - 1) {
-    col = maxx - 1;
+  // Convert the column (an offset into the line) into a screen column, which
+  // may be different if the line has tabs or wide characters, and restrict it
+  // to prevent scrolling off the end of the screen.
+  var screenCol = col;
+  if (line < world.buffer.length) {
+    screenCol = world.buffer.getLine(line).columnOf(col);
+  }
+  if (screenCol > maxx - 1) {
+    screenCol = maxx - 1;
   }
 
   var newy = cury + line - lastline;
@@ -118,6 +114,6 @@ core.addFunction("move", function (line, col) {
     newy = maxy - 1;
   }
   lastline = line;
-  core.windows.buffer.move(newy, col);
-  curses.stdscr.move(newy + 1, col);
+  core.windows.buffer.move(newy, screenCol);
+  curses.stdscr.move(newy + 1, screenCol);
 });
@@ -24,36 +24,18 @@ world.addEventListener("load", function (event) {
   core.windows.buffer.scrollok(true);
 
   core.windows.status = curses.stdscr.subwin(2, curses.stdscr.getmaxx(), curses.stdscr.getmaxy() - 2, 0);
-  // blank out the status line
-  var blanks = "";
-  for (var i = 0; i < curses.stdscr.getmaxx(); i++) {
-    blanks += " ";
-  }
-  core.windows.status.standout();
-  core.windows.status.mvaddstr(0, 0, blanks);
-  core.windows.status.standend();
+  core.statusBar = core.windows.status.createStatusBar();
+  core.defineStatusFields();
   core.drawStatus();
   core.drawStatusRight();
 });
 
 // Draw the buffer contents to the main window.
 world.addEventListener("load", function (event) {
-  var i = 0;
-  var maxy = core.windows.buffer.getmaxy();
-  var buflen = world.buffer.length;
-  if (buflen > maxy) {
-    buflen = maxy;
-  }
-  for (i = 0; i < buflen; i++) {
-    core.windows.buffer.mvaddstr(i, 0, world.buffer.getLine(i).value());
-  }
-
-  core.windows.buffer.attron(colors.getColorPair(curses.COLOR_BLUE, -1));
-  for (; i < maxy; i++) {
-    core.windows.buffer.mvaddstr(i, 0, "~");
-  }
-  core.windows.buffer.attroff(colors.getColorPair(curses.COLOR_BLUE, -1));
-  core.windows.buffer.mvaddstr(0, 0, "");
+  core.viewport = world.buffer.createViewport(core.windows.buffer);
+  core.viewport.tildeAttrs = colors.getColorPair(curses.COLOR_BLUE, -1);
+  core.viewport.draw();
+  core.windows.buffer.move(0, 0);
 });
 
 // set up the refresh on the clock
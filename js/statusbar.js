@@ -32,89 +32,71 @@ core.addFunction("computeStatusSplits", function (index) {
   }
 });
 
-core.addFunction("drawStatus", function () {
+// Define the fields of core.statusBar. The top row of the status window shows
+// the cursor position, how far through the buffer the window is, and the
+// clock; the bottom row shows messages (or the mode), and any vi command that
+// has only been partly typed.
+core.addFunction("defineStatusFields", function () {
+  var bar = core.statusBar;
   var maxx = core.windows.status.getmaxx();
-  core.windows.status.standout();
-  core.windows.status.mvaddstr(0, 0, "  ");
-  var split = core.computeStatusSplits(0);
-  var tabStr = "" + (core.line + 1) + "," + core.column;
-  var ratio = core.windowBottom() * 100 / world.buffer.length;
-  if (ratio > 100) {
-    ratio = 100;
-  }
-  ratio = parseInt(ratio);
-  tabStr += "  (" + ratio + "%)";
-
-  core.windows.status.addstr(tabStr);
+  var left = core.computeStatusSplits(0);
+  var right = core.computeStatusSplits(2);
+  var positionWidth = Math.min(16, left.right);
+  bar.defineField("position", 0, 0, positionWidth, curses.A_STANDOUT);
+  bar.defineField("percentage", 0, positionWidth, right.left - positionWidth,
+                  curses.A_STANDOUT);
+  bar.defineField("clock", 0, right.left, right.right - right.left,
+                  curses.A_STANDOUT, true);
+  bar.defineField("message", 1, 0, maxx - 10, 0);
+  bar.defineField("pending", 1, maxx - 10, 10, 0);
+});
 
-  var spacesNeeded = split.right - split.left - tabStr.length;
-  var spaces = "";
-  for (var i = 0; i < spacesNeeded; i++) {
-    spaces += " ";
+// Update the status bar fields that depend on the cursor and the mode. Only
+// the fields that change are drawn again (by core.updateAllWindows()).
+core.addFunction("drawStatus", function () {
+  var bar = core.statusBar;
+  bar.set("position", "  " + (core.line + 1) + "," + core.column,
+          curses.A_STANDOUT);
+
+  var totalBytes = world.buffer.offsetOfLine(world.buffer.length);
+  var ratio = 100;
+  if (totalBytes > 0) {
+    ratio = world.buffer.offsetOfLine(core.windowBottom()) * 100 / totalBytes;
   }
-  core.windows.status.addstr(spaces);
-  core.windows.status.standend();
-
-  // resetCursor is true if we ultimately need to reset the cursor, or false
-  // if we don't want to reset it (i.e. to keep it in the status area)
-  var resetCursor = true;
+  bar.set("percentage", "(" + parseInt(ratio) + "%)", curses.A_STANDOUT);
 
-  // draw the exBuffer (: commands in vi-mode)
-  core.windows.status.move(1, 0);
-
-  // draw the bottom line; this wrapper helps deal with correctly adding padding
-  var drawn = false;
-  var drawBottom = function (bottom, leaveCursor) {
-    drawn = true;
-    var len = bottom.length;
-    while (bottom.length < maxx - 10) {
-      bottom += " ";
-    }
-    core.windows.status.mvaddstr(1, 0, bottom);
-    if (leaveCursor) {
-      resetCursor = false;
-      curses.move(curses.stdscr.getmaxy() - 1, bottom.length);
-    }
-  };
-
-  var bottomline = '';
-  core.windows.status.clrtoeol();
-  if (core.curmode == 'ex') {
-    drawBottom(':' + core.exBuffer, true);
+  var message = "";
+  var attrs = 0;
+  if (core.curmode == "ex") {
+    message = ":" + core.exBuffer;
   }
-
-  var drawStatusLine = function (fg, bg, text) {
-    core.windows.status.attron(curses.A_BOLD);
-    var colorPair = colors.getColorPair(fg, bg);
-    drawBottom(text);
-    core.windows.status.attron(colorPair);
-    core.windows.status.mvaddstr(1, 0, text);
-    core.windows.status.attroff(colorPair);
-    core.windows.status.attroff(curses.A_BOLD);
+  var colorMessage = function (fg, bg, text) {
+    message = text;
+    attrs = curses.A_BOLD | colors.getColorPair(fg, bg);
   };
-
   if (core.errorText.value()) {
-    drawStatusLine(curses.COLOR_WHITE, curses.COLOR_RED, "ERROR: " +
-                   core.errorText.value());
+    colorMessage(curses.COLOR_WHITE, curses.COLOR_RED, "ERROR: " +
+                 core.errorText.value());
   } else if (core.warningText.value()) {
-    drawStatusLine(curses.COLOR_RED, -1, "WARNING: " + core.warningText.value());
+    colorMessage(curses.COLOR_RED, -1, "WARNING: " + core.warningText.value());
   } else if (core.notificationText.value()) {
-    drawStatusLine(curses.COLOR_GREEN, -1, core.notificationText.value());
+    colorMessage(curses.COLOR_GREEN, -1, core.notificationText.value());
   } else if (core.curmode == "insert") {
-    drawStatusLine(curses.COLOR_YELLOW, -1, "-- INSERT --");
-  } else if (drawn === false) {
-    drawBottom('');
+    colorMessage(curses.COLOR_YELLOW, -1, "-- INSERT --");
   }
-  core.windows.status.addstr(vi.pendingCommand);
+  bar.set("message", message, attrs);
+  bar.set("pending", vi.pendingCommand);
 
-  if (resetCursor) {
+  if (core.curmode == "ex") {
+    // leave the cursor at the end of the : command being typed
+    curses.move(curses.stdscr.getmaxy() - 1, 1 + core.exBuffer.length);
+  } else {
     // move the cursor back to the main editing buffer
-    core.move()
+    core.move();
   }
 });
 
 core.addFunction("drawStatusRight", function () {
-  var split = core.computeStatusSplits(2);
   var fmtTime = function (n) {
     if (n < 10) {
       return new String("0" + n);
@@ -147,10 +129,5 @@ core.addFunction("drawStatusRight", function () {
     statusEnd += " ";
   }
 
-  while (statusEnd.length < split.right - split.left) {
-    statusEnd = " " + statusEnd;
-  }
-  core.windows.status.standout();
-  core.windows.status.mvaddstr(0, split.left, statusEnd);
-  core.windows.status.standend();
+  core.statusBar.set("clock", statusEnd, curses.A_STANDOUT);
 });
@@ -31,9 +31,9 @@ ExFlags.prototype.check = function (flags) {
 var exFlags = new ExFlags();
 
 // The accumulator is what makes commands like 5j or 3dd work. It accumulates
-// digits entered, and runs commands repeatedly. There will only be one instance
-// of the Accumulator class created in normal operation, the variable
-// `accumulator'.
+// digits entered, and passes the count to the next command. There will only be
+// one instance of the Accumulator class created in normal operation, the
+// variable `accumulator'.
 function Accumulator() {
   this.count = 0;
 }
@@ -47,40 +47,152 @@ Accumulator.prototype.addDigit = function (digit) {
   }
 };
 
-// Run a function the appropriate number of times (which is once if the
-// accumulator is empty).
-Accumulator.prototype.run = function (func, data) {
+// Take the count (which is 1 if the accumulator is empty), emptying the
+// accumulator.
+Accumulator.prototype.take = function () {
   var count = this.count || 1;
-  for (var i = 0; i < count; i++) {
-    func(data);
-  }
   this.count = 0;
-}
+  return count;
+};
+
+// Run a function with the count. The function is only called once, and should
+// move count times at once (the buffer's motions, like lineDown(), take a
+// count); it's also told whether a count was entered at all (e.g. for G).
+Accumulator.prototype.run = function (func, data) {
+  var hasCount = this.count !== 0;
+  func(data, this.take(), hasCount);
+};
 
 // The global instance of the accumulator.
 var accumulator = new Accumulator();
 
 var pasteBuffer = '';
 
-var handlerMap = {};
-var incompatibilityMap = {};
+// Keep the cursor in the buffer after lines have been deleted, adding a blank
+// line if the buffer is now empty.
+function afterDelete() {
+  if (!world.buffer.length) {
+    world.buffer.addLine(0, '');
+  }
+  if (core.line >= world.buffer.length) {
+    core.line = world.buffer.length - 1;
+  }
+}
 
-function addHandler(code) {
-  if (arguments.length == 2) {
-    var callback = arguments[1];
-    for (var i = 0; i < code.length; i++) {
-      handlerMap[code[i]] = callback;
-    }
+// Delete on line (the line the cursor was on) from origCol up to where a
+// characterwise motion left the cursor (and including it, for an inclusive
+// motion like $). A motion that left the line deletes to the end (or the
+// start) of the line, so dw on the last word of a line doesn't take the next
+// line with it.
+function deleteChars(line, origLine, origCol, inclusive) {
+  var from = origCol;
+  var to = core.column;
+  if (core.line > origLine) {
+    to = line.length;
+    inclusive = false;
+  } else if (core.line < origLine) {
+    to = 0;
+  }
+  if (to < from) {
+    from = to;
+    to = origCol;
+  }
+  if (inclusive) {
+    to = Math.min(to + 1, line.length);
+  }
+  if (to > from) {
+    line.erase(from, to - from);
+  }
+  core.line = origLine;
+  core.column = Math.min(from, Math.max(line.length - 1, 0));
+}
+
+// Mark a movement as characterwise: d with it deletes characters on the line
+// rather than whole lines. Exclusive motions (like w) don't delete the
+// character they end on, and inclusive ones (like $) do.
+function characterwise(callback, inclusive) {
+  callback.characterwise = inclusive ? 'inclusive' : 'exclusive';
+  return callback;
+}
+
+// Run a command for a key typed in command mode.
+//
+// Movement commands (e.g. hjkl) are compatible with all modifiers, e.g. dj is
+// valid. non-movement commands are usually not compatible with some or all
+// modifiers -- e.g. dJ is an invalid sequence. If we see any
+// incompatibilities, then the command is considered to not be a movement
+// command. Otherwise it is one.
+//
+// Note that some characters are a bit more complicated to handle. For
+// instance, 0 can be a movment, or it can be entered as part of an accumulator
+// sequence, e.g. 10j
+function runCommand(event, incompatibilities, handler) {
+  var ch = event.getChar();
+  var line = core.currentLine();
+  if (incompatibilities) {
+     if (exFlags.check(incompatibilities)) {
+       // If an invalid sequence like dJ was entered, let the user know, and
+       // clear all of the flags.
+       core.warningText.set('invalid commmand "' + exFlags.flags + ch + '"');
+       core.notificationText.clear();
+       exFlags.clear();
+       exports.pendingCommand = '';
+     } else {
+       var waiting = handler(line);
+       if (waiting) {
+         exports.pendingCommand += ch;
+       } else {
+         exports.pendingCommand = '';
+       }
+     }
   } else {
-    var incompatibleFlags = arguments[1];
-    var callback = arguments[2];
-    incompatibilityMap[code] = incompatibleFlags;
-    for (var i = 0; i < code.length; i++) {
-      handlerMap[code[i]] = callback;
+    exports.pendingCommand = '';
+    var change = false;
+    var origCol = core.column;
+    var origLine = core.line;
+    accumulator.run(handler, line);
+    if (exFlags.check('c')) {
+      exFlags.clear();
+      exFlags.setFlag('d');
+      change = true;
+    }
+    if (exFlags.check('d')) {
+      if (handler.characterwise) {
+        deleteChars(line, origLine, origCol,
+                    handler.characterwise === 'inclusive');
+      } else if (origLine !== core.line) {
+        // we need to delete all of the affected lines
+        var smaller = origLine < core.line ? origLine : core.line;
+        var toDelete = 1 + Math.abs(core.line - origLine);
+        log("deleting " + toDelete + " lines");
+        core.line = smaller;  // dk moves the line, but dj doesn't
+        world.buffer.deleteLines(smaller, toDelete);
+        afterDelete();
+      }
+      exFlags.clear()
+    }
+    core.notificationText.clear();
+    if (change) {
+      core.switchMode('insert');
     }
   }
 }
 
+// Bind each key in code (a string of characters, or an array of characters
+// and keypad key codes) to a command in command mode. The optional
+// incompatibleFlags are the flags that the command can't follow (so a command
+// without them is a movement).
+function addHandler(code) {
+  var incompatibleFlags = arguments.length == 2 ? '' : arguments[1];
+  var callback = arguments[arguments.length - 1];
+  var command = function (event) {
+    runCommand(event, incompatibleFlags, callback);
+  };
+  for (var i = 0; i < code.length; i++) {
+    core.bindKey("command", code[i], command);
+  }
+}
+
 addHandler('a', 'cd', function (line) {
   if (core.column < line.length) {
     core.column++;
@@ -97,53 +209,62 @@ addHandler('A', 'cd', function (line) {
 
 addHandler('d', 'c', function () {
   if (exFlags.check('d')) {
-    world.buffer.deleteLine(core.line);
+    // dd deletes count lines at once
+    world.buffer.deleteLines(core.line, accumulator.take());
     core.column = 0;
-    if (!world.buffer.length) {
-      world.buffer.addLine(0, '');
-    }
-    if (core.line >= world.buffer.length) {
-      core.line--;
-    }
+    afterDelete();
     exFlags.clear();
-    var cury = core.windows.buffer.getcury();
-    core.windows.buffer.move(cury, 0);
-    core.windows.buffer.clrtoeol();
-    core.scrollRegion(1, cury);
   } else {
     exFlags.setFlag('d');
     return true;
   }
 });
 
-addHandler(['h', curses.keycodes['KEY_LEFT']], function () {
-  if (core.column > 0) {
-    core.column--;
-  }
+addHandler('b', characterwise(function (line, count) {
+  var pos = world.buffer.wordBackward(core.line, core.column, count);
+  core.line = pos.line;
+  core.column = pos.column;
+}));
+
+addHandler('G', function (line, count, hasCount) {
+  // go to line count (counting from 1), or to the last line
+  var last = world.buffer.length - 1;
+  core.line = hasCount ? world.buffer.gotoLine(count - 1) : last;
+  core.column = world.buffer.lineStart(core.line);
 });
 
+addHandler(['gg'], function (line, count) {
+  core.line = world.buffer.gotoLine(count - 1);
+  core.column = world.buffer.lineStart(core.line);
+});
+
+addHandler(['h', curses.keycodes['KEY_LEFT']],
+           characterwise(function (line, count) {
+  core.column = Math.max(core.column - count, 0);
+}));
+
 addHandler('i', 'cd', function () {
   core.switchMode('insert');
 });
 
 
-addHandler(['j', curses.keycodes['KEY_DOWN']], function () {
-  if (core.line < world.buffer.length - 1) {
-    core.line++;
-  }
+addHandler(['j', curses.keycodes['KEY_DOWN']], function (line, count) {
+  core.line = world.buffer.lineDown(core.line, count);
 });
 
-addHandler(['k', curses.keycodes['KEY_UP']], function () {
-  if (core.line > 0) {
-    core.line--;
-  }
+addHandler(['k', curses.keycodes['KEY_UP']], function (line, count) {
+  core.line = world.buffer.lineUp(core.line, count);
 });
 
-addHandler(['l', curses.keycodes['KEY_RIGHT']], function (line) {
-  if (core.column < line.length - 1) {
-    core.column++;
+addHandler(['l', curses.keycodes['KEY_RIGHT']],
+           characterwise(function (line, count) {
+  // the cursor stops on the last character, but an operator (like dl) can
+  // take the motion one past it, to include that character
+  var end = exFlags.check('cd') ? line.length : line.length - 1;
+  if (core.column < end) {
+    core.column = Math.min(core.column + count, end);
   }
-});
+}));
 
 addHandler('o', 'cd', function () {
   world.buffer.addLine(core.line + 1)
@@ -160,23 +281,37 @@ addHandler('O', 'cd', function () {
   core.switchMode('insert');
 });
 
+addHandler('w', characterwise(function (line, count) {
+  var pos = world.buffer.wordForward(core.line, core.column, count);
+  core.line = pos.line;
+  core.column = pos.column;
+}));
+
 addHandler(':', 'cd', function (line) {
   core.switchMode('ex');
 });
 
-addHandler('$', function (line) {
-  core.column = line.length - 1;
-});
+addHandler('$', characterwise(function (line, count) {
+  // 2$ is the end of the next line, and so on
+  var pos = world.buffer.lineEnd(core.line, count);
+  core.line = pos.line;
+  core.column = pos.column;
+}, true));
+
+addHandler('^', characterwise(function (line) {
+  core.column = world.buffer.lineStart(core.line);
+}));
 
 // FIXME: need to check modes more carefully,
-addHandler('0', function () {
-  if (accumulator.count !== 0) {
-    accumulator.addDigit(0);
-    return true;
+addHandler('0', characterwise(function (line, count, hasCount) {
+  if (hasCount) {
+    // a digit of the count (e.g. 10j), which the accumulator has just given
+    // to this command; put it back
+    accumulator.count = count * 10;
   } else {
     core.column = 0;
   }
-});
+}));
 
 // set a handler for each digit
 (function () {
@@ -191,94 +326,17 @@ addHandler('0', function () {
 })();
 
 
-// The main keypress listener for command mode.
+// The keypress listener for command mode, which is only called for keys that
+// aren't bound.
 core.addKeypressListener("command", function (event) {
-  var ch = event.getChar();
-
-  // get the handler function for this character
-  var isMovement = true;
-  var handler = handlerMap[ch];
-  if (handler === undefined) {
-    handler = handlerMap[event.getCode()];
-  }
-
-  if (handler === undefined) {
-    // the key couldn't be handled
-    var chName;
-    if (event.isPrintable()) {
-      chName = "'" + ch + "'";
-    } else {
-      chName = "keycode " + event.getCode();
-    }
-    core.warningText.set(chName + ' not implemented');
-    exFlags.clear();
+  var chName;
+  if (event.isPrintable()) {
+    chName = "'" + event.getChar() + "'";
   } else {
-    // Movement commands (e.g. hjkl) are compatible with all modifiers, e.g. dj
-    // is valid. non-movement commands are usually not compatible with some or
-    // all modifiers -- e.g. dJ is an invalid sequence. If we see any
-    // incompatibilities, then the command is considered to not be a movement
-    // command. Otherwise it is one.
-    //
-    // Note that some characters are a bit more complicated to handle. For
-    // instance, 0 can be a movment, or it can be entered as part of an
-    // accumulator sequence, e.g. 10j
-    var line = core.currentLine();
-    var incompatibilities = incompatibilityMap[ch];
-    if (incompatibilities) {
-      isMovement = false;
-       if (exFlags.check(incompatibilities)) {
-         // If an invalid sequence like dJ was entered, let the user know, and
-         // clear all of the flags.
-         core.warningText.set('invalid commmand "' + exFlags.flags + ch + '"');
-         core.notificationText.clear();
-         exFlags.clear();
-         exports.pendingCommand = '';
-       } else {
-         var waiting = handler(line);
-         if (waiting) {
-           exports.pendingCommand += ch;
-         } else {
-           exports.pendingCommand = '';
-         }
-       }
-    } else {
-      exports.pendingCommand = '';
-      var change = false;
-      var origCol = core.column;
-      var origLine = core.line;
-      accumulator.run(handler, line);
-      if (exFlags.check('c')) {
-        exFlags.clear();
-        exFlags.setFlag('d');
-        change = true;
-      }
-      if (exFlags.check('d')) {
-        if (origLine !== core.line) {
-          // we need to delete all of the affected lines
-          var smaller = origLine < core.line ? origLine : core.line;
-          var toDelete = 1 + Math.abs(core.line - origLine);
-          log("deleting " + toDelete + " lines");
-          if (origLine < core.line) {
-            // dk moves the line, but dj doesn't. weird, right?
-            core.line = origLine;
-          }
-          core.glitch("about to scroll");
-          core.scrollRegion(toDelete, core.getY(smaller));
-          core.glitch("done with scroll");
-          for (var i = 0; i < toDelete; i++) {
-            world.buffer.deleteLine(smaller);
-          }
-        } else {
-          log("well shucks");
-        }
-        exFlags.clear()
-      }
-      core.notificationText.clear();
-      if (change) {
-        core.switchMode('insert');
-      }
-    }
+    chName = "keycode " + event.getCode();
   }
+  core.warningText.set(chName + ' not implemented');
+  exFlags.clear();
 });
 
 require("js/ex.js");
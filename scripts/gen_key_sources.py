@@ -17,8 +17,7 @@ h_template = """
 
 #include <ctype.h>
 #include <v8.h>
-
-#include <string>
+#include <wchar.h>
 
 using v8::Arguments;
 using v8::Handle;
@@ -27,24 +26,36 @@ using v8::Persistent;
 using v8::Value;
 
 namespace e {
+// There's one KeyCode for each key, which lives for as long as the program
+// does: the ASCII characters and keypad keys are in static tables, and other
+// characters are created the first time they're typed. Each KeyCode has a
+// single script object, which is created when it's first needed and is passed
+// to every event for the key.
 class KeyCode {
  public:
   explicit KeyCode(wint_t code);
-  explicit KeyCode(wint_t code, const std::string &name);
-  ~KeyCode();
-  Persistent<Value> ToScript();
+  explicit KeyCode(wint_t code, const char *name);
+  Handle<Object> ToScript();
+
+  // Get the KeyCode that a script object is for, or nullptr if it isn't a
+  // KeyCode's object
+  static KeyCode* FromScript(Handle<Value> val);
+
   inline wint_t Code() const { return code_; }
   inline bool IsKeypad() const { return is_keypad_; }
-  inline const std::string& Name() const { return name_; }
+  inline const char* Name() const { return name_; }
   inline bool IsPrintable() const {
      return static_cast<bool>(isprint(static_cast<int>(code_)));
   }
  private:
   wint_t code_;
   bool is_keypad_;
-  std::string name_;
+  const char *name_;  // null unless this is a keypad key
+  Persistent<Object> script_;
 };
 
+// Get the KeyCode for a character or keypad key read by curses; the KeyCode
+// is never deleted.
 KeyCode* CursesToKeycode(const wint_t &wch, bool is_keypad);
 Handle<Object> GetKeycodeMap();
 }
@@ -63,7 +74,7 @@ cc_template = """
 #include <v8.h>
 #include <wchar.h>
 
-#include <string>
+#include <map>
 
 #include "./assert.h"
 #include "./embeddable.h"
@@ -116,9 +127,7 @@ Handle<Value> JSGetName(const Arguments& args) {
   HandleScope scope;
   KeyCode *self = Unwrap<KeyCode>(args);
   if (self->IsKeypad()) {
-    const std::string &s = self->Name();
-    Local<String> name = String::NewSymbol(s.c_str(), s.length());
-    return scope.Close(name);
+    return scope.Close(String::NewSymbol(self->Name()));
   } else {
     return scope.Close(String::Empty());
   }
@@ -145,11 +154,15 @@ Handle<Value> JSIsPrintable(const Arguments& args) {
 
 Persistent<ObjectTemplate> keycode_template;
 
+// The second internal field of KeyCodes' objects points here, which tells them
+// apart from the other wrapped objects
+char keycode_tag;
+
 // Create a raw template to assign to keycode_template
 Handle<ObjectTemplate> MakeKeyCodeTemplate() {
   HandleScope scope;
   Handle<ObjectTemplate> result = ObjectTemplate::New();
-  result->SetInternalFieldCount(1);
+  result->SetInternalFieldCount(2);
   result->Set(String::New("getChar"), FunctionTemplate::New(JSGetChar),
     v8::ReadOnly);
   result->Set(String::New("getCode"), FunctionTemplate::New(JSGetCode),
@@ -164,67 +177,72 @@ Handle<ObjectTemplate> MakeKeyCodeTemplate() {
 }
 }
 
-KeyCode::KeyCode(wint_t code, const std::string &name)
+KeyCode::KeyCode(wint_t code, const char *name)
     :code_(code), is_keypad_(true), name_(name) {
 }
 
 KeyCode::KeyCode(wint_t code)
-    :code_(code), is_keypad_(false) {
-}
-
-KeyCode::~KeyCode() {
+    :code_(code), is_keypad_(false), name_(nullptr) {
 }
 
-namespace {
-// this callback will be invoked when the V8 keypress object is GC'ed
-void CleanupKeycode(Persistent<Value> val, void*) {
-  HandleScope scope;
-  ASSERT(val->IsObject());
-  Local<Object> obj = val->ToObject();
-  KeyCode *kc = UnwrapObj<KeyCode>(obj);
-  delete kc;
-  val.Dispose();
-}
+Handle<Object> KeyCode::ToScript() {
+  if (script_.IsEmpty()) {
+    HandleScope scope;
+    if (keycode_template.IsEmpty()) {
+      Handle<ObjectTemplate> raw_template = MakeKeyCodeTemplate();
+      keycode_template = Persistent<ObjectTemplate>::New(raw_template);
+    }
+    script_ = Persistent<Object>::New(keycode_template->NewInstance());
+    ASSERT(script_->InternalFieldCount() == 2);
+    script_->SetInternalField(0, External::New(this));
+    script_->SetInternalField(1, External::New(&keycode_tag));
+  }
+  return script_;
 }
 
-Persistent<Value> KeyCode::ToScript() {
-  HandleScope scope;
-
-  if (keycode_template.IsEmpty()) {
-    Handle<ObjectTemplate> raw_template = MakeKeyCodeTemplate();
-    keycode_template = Persistent<ObjectTemplate>::New(raw_template);
+KeyCode* KeyCode::FromScript(Handle<Value> val) {
+  if (!val->IsObject()) {
+    return nullptr;
   }
-
-  Persistent<Object> kc = Persistent<Object>::New(
-          keycode_template->NewInstance());
-
-  kc.MakeWeak(nullptr, CleanupKeycode);
-
-  ASSERT(kc->InternalFieldCount() == 1);
-  kc->SetInternalField(0, External::New(this));
-  return kc;
+  Handle<Object> obj = Handle<Object>::Cast(val);
+  if (obj->InternalFieldCount() != 2 ||
+      UnwrapObj<void>(obj, 1) != &keycode_tag) {
+    return nullptr;
+  }
+  return UnwrapObj<KeyCode>(obj);
 }
 
 namespace {
 const size_t max_code = %(max_code)d;
-const char * keycode_arr[%(arr_size)d] = {
-%(codes)s
+
+// the keys for the ASCII characters, indexed by code
+KeyCode ascii_keys[128] = {
+%(ascii_keys)s
+};
+
+// the keypad keys, indexed by code (codes that aren't keys have no name)
+KeyCode keypad_keys[%(arr_size)d] = {
+%(keypad_keys)s
 };
+
+// the keys for the other characters typed so far
+std::map<wint_t, KeyCode*> other_keys;
 }
 
 KeyCode* CursesToKeycode(const wint_t &wch, bool is_keypad) {
-  // The returned pointers are "owned" by V8; the way they'll get deleted
-  // later on is by CleanupKeycode, which will be invoked when the containing
-  // V8 object is garbage collected.
   if (is_keypad) {
     size_t offset = static_cast<size_t>(wch);
     ASSERT(offset <= max_code);
-    const char *name = keycode_arr[offset];
-    ASSERT(name != nullptr);
-    return new KeyCode(wch, name);
-  } else {
-    return new KeyCode(wch);
+    ASSERT(keypad_keys[offset].Name() != nullptr);
+    return &keypad_keys[offset];
+  } else if (wch < 128) {
+    return &ascii_keys[wch];
   }
+  KeyCode *&key = other_keys[wch];
+  if (key == nullptr) {
+    key = new KeyCode(wch);
+  }
+  return key;
 }
 
 Handle<Object> GetKeycodeMap() {
@@ -317,39 +335,35 @@ if __name__ == '__main__':
     cc_name = opts.output_prefix + '.cc'
 
     printable = '0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ!"#$%&\'()*+,-./:;<=>?@[\\]^_`{|}~ '
-    code_arr = []
+    ascii_arr = ['  KeyCode(%d),' % (code,) for code in xrange(128)]
+    keypad_arr = []
     map_arr = []
-    comment_width = 30
+    comment_width = 40
     for code in xrange(max_code + 1):
         if code and code in value_map:
             name, description = value_map[code]
-            val = '      "%s",' % (name,)
+            val = '  KeyCode(%d, "%s"),' % (code, name)
             val += ' ' * (comment_width - len(val))
             val += '// %s' % (description,)
-            code_arr.append(val)
+            keypad_arr.append(val)
             map_arr.append('arr->Set(String::New("%s"), Integer::New(%d), v8::ReadOnly);' % (name, code));
-        elif code < 128:
-            name = chr(code)
-            if name in printable:
-                name = name.replace('\\', '\\\\')
-                name = name.replace('"', '\\"')
-                code_arr.append('      "%s",' % (name,))
-                map_arr.append('arr->Set(String::New("%s"), Integer::New(%d), v8::ReadOnly);' % (name, code));
-            else:
-                code_arr.append('      "\\x%02x",' % (code,))
         else:
-            val = '      nullptr,'
-            val += ' ' * (comment_width - len(val))
-            val += '// keycode %d' % (code,)
-            code_arr.append(val)
+            keypad_arr.append('  KeyCode(%d, nullptr),' % (code,))
+            if code < 128:
+                name = chr(code)
+                if name in printable:
+                    name = name.replace('\\', '\\\\')
+                    name = name.replace('"', '\\"')
+                    map_arr.append('arr->Set(String::New("%s"), Integer::New(%d), v8::ReadOnly);' % (name, code));
 
     with open(h_name, 'w') as h_file:
         h_file.write(h_template.lstrip() % {'current_year': current_year})
 
     with open(cc_name, 'w') as cc_file:
         cc_file.write(cc_template.lstrip() % ({'arr_size': max_code + 1,
+                                               'ascii_keys': '\n'.join(ascii_arr),
                                                'current_year': current_year,
-                                               'codes': '\n'.join(code_arr),
+                                               'keypad_keys': '\n'.join(keypad_arr),
                                                'h_name': os.path.basename(h_name),
                                                'keycode_map_code': '\n  '.join(map_arr),
                                                'max_code': max_code}))
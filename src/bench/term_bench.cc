@@ -0,0 +1,199 @@
+// Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+//
+// Benchmark for the direct terminal output backend in term_output.cc, compared
+// to ncurses' own wnoutrefresh()/doupdate(). Both draw the same sequence of
+// frames (typing on a line, scrolling the buffer every few frames, and
+// updating the status bar) and write the output to a temporary file; the
+// bytes emitted and the CPU time used per frame are reported.
+//
+// The direct backend is run twice: once waiting for the render thread after
+// every frame (so the time includes drawing the frame), and once without
+// waiting, which reports only the time the main thread spends on each frame.
+//
+// Usage: term_bench [num_frames]
+//
+// The terminal type is taken from $TERM, and the screen size from $LINES and
+// $COLUMNS (or the terminfo entry).
+
+#include <time.h>
+
+#ifdef USE_NCURSESW
+#ifdef PLATFORM_LINUX
+#ifndef _XOPEN_SOURCE_EXTENDED
+#define _XOPEN_SOURCE_EXTENDED
+#endif  // _X_OPEN_SOURCE_EXTENDED
+#include <ncursesw/curses.h>
+#else
+#include <curses.h>
+#endif  // PLATFORM_LINUX
+#else  // USE_NCURSESW
+#include <curses.h>  // NOLINT
+#endif  // USE_NCURSESW
+
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "../term_output.h"
+
+namespace {
+const char *samples[] = {
+  "  for (size_t i = 0; i < lines_.Size(); i++) {",
+  "    Line *l = lines_[i];",
+  "    l->SetIndex(i);",
+  "  }",
+  "",
+  "// caf\xc3\xa9, na\xc3\xafve, se\xc3\xb1or",
+  "return \"\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e\";  // wide characters",
+};
+const int num_samples = sizeof(samples) / sizeof(samples[0]);
+
+double CpuTime(clockid_t clock = CLOCK_PROCESS_CPUTIME_ID) {
+  timespec ts;
+  clock_gettime(clock, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void DrawTextRow(WINDOW *win, int y, int line) {
+  mvwaddstr(win, y, 0, samples[line % num_samples]);
+  wclrtoeol(win);
+}
+
+// Draw a frame the way the editor does: the buffer window scrolls by a line
+// every eight frames, one line is being typed on, and the status bar shows
+// the cursor position.
+void DrawFrame(WINDOW *win, int frame) {
+  const int rows = getmaxy(win);
+  const int cols = getmaxx(win);
+  const int text_rows = rows - 3;
+  const int top = frame / 8;
+  const int typing_row = text_rows / 2;
+
+  if (frame == 0) {
+    wattrset(win, A_NORMAL);
+    werase(win);
+    wattrset(win, A_REVERSE);
+    mvwaddstr(win, 0, 0, " term_bench ");
+    wattrset(win, A_NORMAL);
+    for (int y = 0; y < text_rows; y++) {
+      DrawTextRow(win, y + 1, top + y);
+    }
+  } else if (frame % 8 == 0) {
+    scrollok(win, TRUE);
+    wsetscrreg(win, 1, text_rows);
+    wscrl(win, 1);
+    wsetscrreg(win, 0, rows - 1);
+    scrollok(win, FALSE);
+    DrawTextRow(win, text_rows, top + text_rows - 1);
+  }
+
+  // the line being typed on grows by a character each frame
+  std::string typed(frame % (cols - 1), 'x');
+  wattrset(win, COLOR_PAIR(1));
+  mvwaddstr(win, typing_row + 1, 0, typed.c_str());
+  wattrset(win, A_NORMAL);
+  wclrtoeol(win);
+
+  char status[64];
+  snprintf(status, sizeof(status), " line %d, column %d ", top + typing_row,
+           static_cast<int>(typed.size()));
+  wattrset(win, A_STANDOUT);
+  mvwaddstr(win, rows - 2, 0, status);
+  for (int x = getcurx(win); x < cols; x++) {
+    waddch(win, ' ');
+  }
+  wattrset(win, A_NORMAL);
+  wmove(win, rows - 1, 0);
+  wclrtoeol(win);
+  if (frame % 16 < 8) {
+    mvwaddstr(win, rows - 1, 0, "-- INSERT --");
+  }
+  wmove(win, typing_row + 1, static_cast<int>(typed.size()));
+}
+
+void Report(const char *name, int num_frames, long bytes,  // NOLINT
+            double elapsed) {
+  printf("%-10s %10.1f bytes/frame %8.2f us/frame\n", name,
+         static_cast<double>(bytes) / num_frames, elapsed * 1e6 / num_frames);
+}
+}
+
+int main(int argc, char **argv) {
+  int num_frames = 2000;
+  if (argc > 1) {
+    num_frames = atoi(argv[1]);
+  }
+  setlocale(LC_ALL, "");
+  const char *term = getenv("TERM");
+  if (term == nullptr) {
+    term = "xterm-256color";
+  }
+
+  FILE *in = fopen("/dev/null", "r");
+  FILE *ncurses_out = tmpfile();
+  FILE *direct_out = tmpfile();
+  FILE *threaded_out = tmpfile();
+  SCREEN *screen = newterm(term, ncurses_out, in);
+  if (screen == nullptr) {
+    fprintf(stderr, "failed to set up terminal \"%s\"\n", term);
+    return 1;
+  }
+  set_term(screen);
+  start_color();
+  use_default_colors();
+  init_pair(1, COLOR_BLUE, -1);
+  printf("%d frames on a %dx%d %s terminal\n\n", num_frames, COLS, LINES,
+         term);
+
+  // ncurses: the editor calls wnoutrefresh() on its windows, then doupdate()
+  idlok(stdscr, TRUE);
+  double start = CpuTime();
+  for (int i = 0; i < num_frames; i++) {
+    DrawFrame(stdscr, i);
+    wnoutrefresh(stdscr);
+    doupdate();
+  }
+  double elapsed = CpuTime() - start;
+  fflush(ncurses_out);
+  Report("ncurses", num_frames, ftell(ncurses_out), elapsed);
+
+  // the direct backend, drawing from a separate window so that it starts from
+  // a blank screen too
+  WINDOW *win = newwin(LINES, COLS, 0, 0);
+  {
+    e::TermOutput output(fileno(direct_out));
+    start = CpuTime();
+    for (int i = 0; i < num_frames; i++) {
+      DrawFrame(win, i);
+      output.Compose(win);
+      output.Flush();
+      output.Wait();
+    }
+    elapsed = CpuTime() - start;
+    Report("direct", num_frames,
+           static_cast<long>(output.BytesWritten()), elapsed);  // NOLINT
+  }
+  delwin(win);
+
+  // the direct backend again, without waiting for each frame to be written
+  // (so frames may be skipped if the render thread falls behind)
+  win = newwin(LINES, COLS, 0, 0);
+  {
+    e::TermOutput output(fileno(threaded_out));
+    start = CpuTime(CLOCK_THREAD_CPUTIME_ID);
+    for (int i = 0; i < num_frames; i++) {
+      DrawFrame(win, i);
+      output.Compose(win);
+      output.Flush();
+    }
+    elapsed = CpuTime(CLOCK_THREAD_CPUTIME_ID) - start;
+    output.Wait();
+    Report("threaded", num_frames,
+           static_cast<long>(output.BytesWritten()), elapsed);  // NOLINT
+  }
+  delwin(win);
+  endwin();
+  delscreen(screen);
+  return 0;
+}
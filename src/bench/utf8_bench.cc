@@ -0,0 +1,129 @@
+// Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+//
+// Benchmark for the UTF-8 <-> UTF-16 conversion routines in utf8.cc, compared
+// to the code paths they replaced: widening bytes one at a time when decoding,
+// and going through a V8 string when encoding.
+//
+// Usage: utf8_bench [num_lines]
+
+#include <time.h>
+#include <v8.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../utf8.h"
+
+using v8::Context;
+using v8::HandleScope;
+using v8::Local;
+using v8::Persistent;
+using v8::String;
+
+namespace {
+// A mix of scripts: ASCII source code, accented Latin, Cyrillic, CJK, and
+// characters outside the BMP.
+const char *samples[] = {
+  "  for (size_t i = 0; i < lines_.Size(); i++) {",
+  "// caf\xc3\xa9, na\xc3\xafve, se\xc3\xb1or, \xc3\xa5ngstr\xc3\xb6m",
+  "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82, \xd0\xbc\xd0\xb8\xd1\x80",
+  "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e\xe3\x81\xae\xe3\x83\x86\xe3\x82\xad"
+  "\xe3\x82\xb9\xe3\x83\x88 (Japanese text)",
+  "return \"\xf0\x9f\x98\x80 \xf0\x9f\x9a\x80\";  // emoji",
+};
+
+double Now() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void Report(const char *name, size_t bytes, double elapsed) {
+  printf("%-28s %8.1f ms  %8.1f MB/s\n", name, elapsed * 1000,
+         bytes / elapsed / (1 << 20));
+}
+}
+
+int main(int argc, char **argv) {
+  size_t num_lines = 200000;
+  if (argc > 1) {
+    num_lines = static_cast<size_t>(atol(argv[1]));
+  }
+  const size_t num_samples = sizeof(samples) / sizeof(samples[0]);
+
+  std::vector<std::string> lines;
+  size_t total_bytes = 0;
+  for (size_t i = 0; i < num_lines; i++) {
+    lines.push_back(samples[i % num_samples]);
+    total_bytes += lines.back().size();
+  }
+  printf("%zd lines, %zd bytes of mixed-script text\n\n", num_lines,
+         total_bytes);
+
+  // decoding: the old Line::Replace() widened each byte
+  std::vector<std::vector<uint16_t> > decoded(num_lines);
+  double start = Now();
+  for (size_t i = 0; i < num_lines; i++) {
+    std::vector<uint16_t> &data = decoded[i];
+    data.clear();
+    for (auto it = lines[i].begin(); it != lines[i].end(); ++it) {
+      data.push_back(static_cast<uint16_t>(*it));
+    }
+  }
+  Report("decode (byte widening)", total_bytes, Now() - start);
+
+  start = Now();
+  for (size_t i = 0; i < num_lines; i++) {
+    decoded[i].clear();
+    e::Utf8ToUtf16(lines[i].data(), lines[i].size(), &decoded[i]);
+  }
+  Report("decode (Utf8ToUtf16)", total_bytes, Now() - start);
+
+  start = Now();
+  size_t valid = 0;
+  for (size_t i = 0; i < num_lines; i++) {
+    valid += e::IsValidUtf8(lines[i].data(), lines[i].size());
+  }
+  Report("validate (IsValidUtf8)", total_bytes, Now() - start);
+  if (valid != num_lines) {
+    fprintf(stderr, "validation failed!\n");
+    return 1;
+  }
+
+  // encoding: the old Line::ToString() made a V8 string and used WriteUtf8()
+  {
+    HandleScope scope;
+    Persistent<Context> context = Context::New();
+    Context::Scope context_scope(context);
+    start = Now();
+    for (size_t i = 0; i < num_lines; i++) {
+      HandleScope inner_scope;
+      const std::vector<uint16_t> &data = decoded[i];
+      std::unique_ptr<uint16_t[]> buf(new uint16_t[data.size()]);
+      std::copy(data.begin(), data.end(), buf.get());
+      Local<String> jstr = String::New(buf.get(), data.size());
+      std::unique_ptr<char[]> out(new char[jstr->Utf8Length() + 1]);
+      jstr->WriteUtf8(out.get(), jstr->Utf8Length());
+      std::string s(out.get(), jstr->Utf8Length());
+    }
+    Report("encode (V8 WriteUtf8)", total_bytes, Now() - start);
+    context.Dispose();
+  }
+
+  start = Now();
+  std::string encoded;
+  for (size_t i = 0; i < num_lines; i++) {
+    encoded.clear();
+    e::Utf16ToUtf8(decoded[i].data(), decoded[i].size(), &encoded);
+    if (encoded != lines[i]) {
+      fprintf(stderr, "round trip failed on line %zd!\n", i);
+      return 1;
+    }
+  }
+  Report("encode (Utf16ToUtf8)", total_bytes, Now() - start);
+  return 0;
+}
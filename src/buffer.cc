@@ -17,6 +17,7 @@
 #include "./js.h"
 #include "./logging.h"
 #include "./mmap.h"
+#include "./viewport.h"
 
 using v8::AccessorInfo;
 using v8::Arguments;
@@ -44,6 +45,11 @@ Buffer::Buffer(const std::string &name, const std::string &filepath)
 }
 
 Buffer::~Buffer() {
+  // copy the observers, since they may unregister themselves
+  std::vector<BufferObserver *> observers(observers_);
+  for (BufferObserver *observer : observers) {
+    observer->BufferDeleted();
+  }
   // FIXME(eklitzke): add iterators to Zipper to do this directly
   for (size_t i = 0; i < lines_.Size(); i++) {
     delete lines_[i];
@@ -67,19 +73,28 @@ bool Buffer::OpenFile(const std::string &filepath) {
   for (size_t i = 0; i < lines_.Size(); i++) {
     delete lines_[i];
   }
+  const size_t old_size = lines_.Size();
   lines_.Clear();
+  tree_.Clear();
+  changed_lines_.clear();
+  for (BufferObserver *observer : observers_) {
+    observer->LinesErased(0, old_size);
+  }
 
-  // read each line of the file into a new std::string, and store the string
-  // into lines
+  // decode each line of the file directly from the mapping
   char *mmaddr = static_cast<char *>(mapping.GetMapping());
   const size_t mmlen = mapping.Size();
   if (mmlen == 0) {
     AppendLine("");  // an empty file still has a blank line in it
   } else {
     char *p = mmaddr;
-    while (p < mmaddr + mmlen) {
-      char *n = static_cast<char *>(memchr(p, '\n', mmaddr + mmlen - p));
-      AppendLine(std::string(p, n - p));
+    char *end = mmaddr + mmlen;
+    while (p < end) {
+      char *n = static_cast<char *>(memchr(p, '\n', end - p));
+      if (n == nullptr) {
+        n = end;  // the last line has no trailing newline
+      }
+      AppendLine(p, n - p);
       p = n + sizeof(char);  // NOLINT
     }
   }
@@ -115,15 +130,22 @@ void Buffer::Persist(const std::string &filepath) {
   int fd = mkstemps(filename.get(), 1);
   ASSERT(fd >= 0);
 
+  // encode lines into a single buffer, and write it out in large chunks
+  const size_t chunk_size = 1 << 16;
+  std::string chunk;
+  chunk.reserve(chunk_size);
   for (size_t i = 0; i < lines_.Size(); i++) {
-    std::string line = lines_[i]->ToString();
-    size_t written = 0;
-    while (written < line.length()) {
-      ssize_t w = write(fd, line.c_str() + written, line.length() - written);
-      ASSERT(w >= 0);
-      written += w;
+    lines_[i]->AppendUtf8(&chunk);
+    chunk.push_back('\n');
+    if (chunk.size() >= chunk_size || i + 1 == lines_.Size()) {
+      size_t written = 0;
+      while (written < chunk.size()) {
+        ssize_t w = write(fd, chunk.data() + written, chunk.size() - written);
+        ASSERT(w >= 0);
+        written += w;
+      }
+      chunk.clear();
     }
-    ASSERT(write(fd, "\n", 1) == 1);
   }
   ASSERT(fsync(fd) == 0);
   ASSERT(rename(filename.get(), filepath.c_str()) == 0);
@@ -140,29 +162,305 @@ const std::string & Buffer::GetFilePath() const {
 }
 
 Line* Buffer::Insert(size_t offset, const std::string &s) {
-  Line *l;
-  size_t size = Size();
-  if (offset < size) {
-    l = new Line(s);
-    lines_.Insert(offset, l);
-  } else if (offset == size) {
-    l = new Line(s);
-    AppendLine(s);
-  } else {
-    ASSERT(false);
-    l = nullptr;  // not reached
-  }
+  Line *l = new Line(s);
+  InsertLine(offset, l);
   return l;
 }
 
-void Buffer::Erase(size_t offset) {
-  ASSERT(offset < Size());
-  Line *l = lines_[offset];
-  delete l;
-  lines_.Erase(offset);
+namespace {
+inline bool IsLineBreak(uint16_t c) {
+  return c == '\n' || c == '\r';
+}
+
+const uint16_t* FindLineBreak(const uint16_t *p, const uint16_t *end) {
+  while (p < end && !IsLineBreak(*p)) {
+    p++;
+  }
+  return p;
+}
+
+// Skip the line break at p, treating "\r\n" as a single line break
+const uint16_t* SkipLineBreak(const uint16_t *p, const uint16_t *end) {
+  if (*p++ == '\r' && p < end && *p == '\n') {
+    p++;
+  }
+  return p;
+}
+}
+
+std::pair<size_t, size_t> Buffer::InsertText(size_t line, size_t column,
+                                             const uint16_t *text,
+                                             size_t length) {
+  ASSERT(line < Size());
+  Line *first = lines_[line];
+  column = std::min(column, first->Size());
+
+  const uint16_t *p = text;
+  const uint16_t *end = text + length;
+  const uint16_t *brk = FindLineBreak(p, end);
+  if (brk == end) {
+    first->Insert(column, text, length);
+    return std::make_pair(line, column + length);
+  }
+
+  // split the first line, keeping the part after the insertion point to go at
+  // the end of the last inserted line
+  const uint16_t *data = first->Data();
+  std::vector<uint16_t> tail(data + column, data + first->Size());
+  first->Chop(column);
+  first->Append(p, brk - p);
+
+  std::vector<Line *> new_lines;
+  do {
+    p = SkipLineBreak(brk, end);
+    brk = FindLineBreak(p, end);
+    Line *l = new Line();
+    l->Append(p, brk - p);
+    new_lines.push_back(l);
+  } while (brk != end);
+  const size_t end_column = new_lines.back()->Size();
+  new_lines.back()->Append(tail.data(), tail.size());
+
+  const size_t offset = line + 1;
+  std::vector<size_t> bytes;
+  std::vector<LineNode *> nodes;
+  bytes.reserve(new_lines.size());
+  nodes.reserve(new_lines.size());
+  for (Line *l : new_lines) {
+    l->SetObserver(this);
+    bytes.push_back(l->Utf8Size() + 1);
+  }
+  tree_.Insert(offset, bytes, &nodes);
+  for (size_t i = 0; i < new_lines.size(); i++) {
+    new_lines[i]->SetNode(nodes[i]);
+  }
+  lines_.Insert(offset, new_lines.data(), new_lines.size());
+  for (BufferObserver *observer : observers_) {
+    observer->LinesInserted(offset, new_lines.size());
+  }
+  return std::make_pair(line + new_lines.size(), end_column);
+}
+
+void Buffer::InsertLine(size_t offset, Line *line) {
+  ASSERT(offset <= Size());
+  line->SetObserver(this);
+  std::vector<LineNode *> nodes;
+  tree_.Insert(offset, std::vector<size_t>(1, line->Utf8Size() + 1),
+                  &nodes);
+  line->SetNode(nodes[0]);
+  lines_.Insert(offset, line);
+  for (BufferObserver *observer : observers_) {
+    observer->LinesInserted(offset, 1);
+  }
+}
+
+void Buffer::Erase(size_t offset, size_t count) {
+  ASSERT(offset + count <= Size());
+  if (count == 0) {
+    return;
+  }
+  std::vector<Line *> erased;
+  erased.reserve(count);
+  for (size_t i = offset; i < offset + count; i++) {
+    erased.push_back(lines_[i]);
+  }
+  if (!changed_lines_.empty()) {
+    std::sort(erased.begin(), erased.end());
+    changed_lines_.erase(
+        std::remove_if(changed_lines_.begin(), changed_lines_.end(),
+                       [&erased](Line *l) {
+                         return std::binary_search(erased.begin(),
+                                                   erased.end(), l);
+                       }),
+        changed_lines_.end());
+  }
+  for (Line *l : erased) {
+    delete l;
+  }
+  lines_.Erase(offset, count);
+  tree_.Erase(offset, count);
+  for (BufferObserver *observer : observers_) {
+    observer->LinesErased(offset, count);
+  }
+}
+
+void Buffer::AddObserver(BufferObserver *observer) {
+  observers_.push_back(observer);
+}
+
+void Buffer::RemoveObserver(BufferObserver *observer) {
+  observers_.erase(std::remove(observers_.begin(), observers_.end(), observer),
+                   observers_.end());
+}
+
+void Buffer::LineChanged(Line *line) {
+  if (!observers_.empty()) {
+    const size_t index = IndexOf(line);
+    for (BufferObserver *observer : observers_) {
+      observer->LinesModified(index, 1);
+    }
+  }
+  if (!changed_lines_.empty() && changed_lines_.back() == line) {
+    return;  // the common case, i.e. typing into a line
+  }
+  if (changed_lines_.size() >= 256) {
+    UpdateOffsets();  // don't let the list grow without bound
+  }
+  changed_lines_.push_back(line);
+}
+
+void Buffer::UpdateOffsets() {
+  for (Line *line : changed_lines_) {
+    tree_.SetWeight(line->Node(), line->Utf8Size() + 1);
+  }
+  changed_lines_.clear();
+}
+
+size_t Buffer::OffsetOfLine(size_t line) {
+  UpdateOffsets();
+  return tree_.PrefixSum(std::min(line, Size()));
+}
+
+size_t Buffer::LineOfOffset(size_t offset) {
+  if (Size() == 0) {
+    return 0;
+  }
+  UpdateOffsets();
+  size_t line = tree_.Search(offset);
+  return line < Size() ? line : Size() - 1;
 }
 
 namespace {
+enum CharClass {
+  BLANK = 0,
+  WORD,
+  PUNCTUATION
+};
+
+inline CharClass ClassOf(uint16_t c) {
+  if (c == ' ' || c == '\t') {
+    return BLANK;
+  } else if (c == '_' || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+             (c >= 'A' && c <= 'Z') || c >= 0x80) {
+    return WORD;
+  }
+  return PUNCTUATION;
+}
+}
+
+size_t Buffer::LineStart(size_t line) {
+  if (line >= Size()) {
+    return 0;
+  }
+  Line *l = lines_[line];
+  const uint16_t *data = l->Data();
+  const size_t len = l->Size();
+  size_t column = 0;
+  while (column < len && ClassOf(data[column]) == BLANK) {
+    column++;
+  }
+  return column < len ? column : (len ? len - 1 : 0);
+}
+
+std::pair<size_t, size_t> Buffer::LineEnd(size_t line, size_t count) {
+  if (Size() == 0) {
+    return std::make_pair(0, 0);
+  }
+  line = LineDown(line, count ? count - 1 : 0);
+  const size_t len = lines_[line]->Size();
+  return std::make_pair(line, len ? len - 1 : 0);
+}
+
+std::pair<size_t, size_t> Buffer::WordForward(size_t line, size_t column,
+                                              size_t count) {
+  if (Size() == 0) {
+    return std::make_pair(0, 0);
+  }
+  line = std::min(line, Size() - 1);
+  for (size_t n = 0; n < count; n++) {
+    Line *l = lines_[line];
+    const uint16_t *data = l->Data();
+    size_t len = l->Size();
+
+    // skip the rest of the current word
+    if (column < len) {
+      const CharClass cls = ClassOf(data[column]);
+      if (cls != BLANK) {
+        while (column < len && ClassOf(data[column]) == cls) {
+          column++;
+        }
+      }
+    }
+
+    // then the blanks (and line breaks) after it, stopping at an empty line
+    while (true) {
+      if (column >= len) {
+        if (line + 1 == Size()) {
+          // there are no more words; stop on the last character
+          return std::make_pair(line, len ? len - 1 : 0);
+        }
+        l = lines_[++line];
+        data = l->Data();
+        len = l->Size();
+        column = 0;
+        if (len == 0) {
+          break;
+        }
+      } else if (ClassOf(data[column]) == BLANK) {
+        column++;
+      } else {
+        break;
+      }
+    }
+  }
+  return std::make_pair(line, column);
+}
+
+std::pair<size_t, size_t> Buffer::WordBackward(size_t line, size_t column,
+                                               size_t count) {
+  if (Size() == 0) {
+    return std::make_pair(0, 0);
+  }
+  line = std::min(line, Size() - 1);
+  column = std::min(column, lines_[line]->Size());
+  for (size_t n = 0; n < count; n++) {
+    // move back a character at a time, past any blanks (and line breaks),
+    // stopping at an empty line
+    const uint16_t *data;
+    size_t len;
+    do {
+      if (column > 0) {
+        column--;
+      } else if (line > 0) {
+        const size_t prev_len = lines_[--line]->Size();
+        column = prev_len ? prev_len - 1 : 0;
+      } else {
+        return std::make_pair(0, 0);
+      }
+      data = lines_[line]->Data();
+      len = lines_[line]->Size();
+    } while (len != 0 && ClassOf(data[column]) == BLANK);
+
+    // then to the start of the word
+    if (len != 0) {
+      const CharClass cls = ClassOf(data[column]);
+      while (column > 0 && ClassOf(data[column - 1]) == cls) {
+        column--;
+      }
+    }
+  }
+  return std::make_pair(line, column);
+}
+
+namespace {
+// Make a {line, column} object for a position
+Local<Object> PositionToScript(const std::pair<size_t, size_t> &pos) {
+  Local<Object> result = Object::New();
+  result->Set(String::NewSymbol("line"), Integer::New(pos.first));
+  result->Set(String::NewSymbol("column"), Integer::New(pos.second));
+  return result;
+}
+
 // @class: Buffer
 // @description: The internal representation of a buffer.
 //
@@ -171,37 +469,97 @@ namespace {
 // @description: Adds a line to the buffer.
 Handle<Value> JSAddLine(const Arguments& args) {
   CHECK_ARGS(1);
-  GET_SELF(Buffer);
+  GET_LIVE_SELF(Buffer);
 
   uint32_t offset = args[0]->Uint32Value();
   std::string lineValue;
   if (args.Length() >= 2) {
-    String::AsciiValue value(args[1]);  // FIXME(eklitzke): handle unicode
+    String::Utf8Value value(args[1]);
     lineValue.insert(0, *value, value.length());
   }
   Line *line = self->Insert(static_cast<size_t>(offset), lineValue);
   return scope.Close(line->ToScript());
 }
 
+// @method: createViewport
+// @param[window]: #object the `curses.Window` to draw into
+// @description: Creates a `Viewport` that draws the buffer into a window.
+Handle<Value> JSCreateViewport(const Arguments& args) {
+  CHECK_ARGS(1);
+  GET_LIVE_SELF(Buffer);
+
+  JSCursesWindow *window = JSCursesWindow::FromScript(args[0]);
+  if (window == nullptr) {
+    return scope.Close(v8::ThrowException(v8::Exception::TypeError(
+        String::New("createViewport() expects a window"))));
+  }
+  Viewport *viewport = new Viewport(self, window, args[0]->ToObject());
+  return scope.Close(viewport->ToScript());
+}
+
+// @method: insertText
+// @param[line]: #int the line to insert the text in
+// @param[column]: #int the offset in the line to insert the text at
+// @param[text]: #string the text to insert
+// @description: Inserts text into the buffer, splitting it into lines at line
+//               breaks, and returns an object with the `line` and `column`
+//               just past the end of the inserted text. This is much faster
+//               than inserting the text a line at a time (e.g. for pastes).
+Handle<Value> JSInsertText(const Arguments& args) {
+  CHECK_ARGS(3);
+  GET_LIVE_SELF(Buffer);
+
+  size_t line = static_cast<size_t>(args[0]->Uint32Value());
+  size_t column = static_cast<size_t>(args[1]->Uint32Value());
+  if (line >= self->Size()) {
+    return scope.Close(v8::ThrowException(v8::Exception::RangeError(
+        String::New("line out of range"))));
+  }
+  String::Value text(args[2]);
+  std::pair<size_t, size_t> pos = self->InsertText(
+      line, column, *text, static_cast<size_t>(text.length()));
+
+  return scope.Close(PositionToScript(pos));
+}
+
 // @method: deleteLine
 // @param[offset]: #int line number of the line to delete
 // @description: Removes a line from the buffer; returns true if the line was
 //               deleted, false otherwise.
 Handle<Value> JSDeleteLine(const Arguments& args) {
   CHECK_ARGS(1);
-  GET_SELF(Buffer);
+  GET_LIVE_SELF(Buffer);
 
   uint32_t offset = args[0]->Uint32Value();
   self->Erase(static_cast<size_t>(offset));
   return scope.Close(Boolean::New(true));
 }
 
+// @method: deleteLines
+// @param[offset]: #int line number of the first line to delete
+// @param[count]: #int the number of lines to delete
+// @description: Removes lines from the buffer all at once (stopping at the end
+//               of the buffer); returns the number of lines deleted.
+Handle<Value> JSDeleteLines(const Arguments& args) {
+  CHECK_ARGS(2);
+  GET_LIVE_SELF(Buffer);
+
+  size_t offset = static_cast<size_t>(args[0]->Uint32Value());
+  size_t count = static_cast<size_t>(args[1]->Uint32Value());
+  if (offset >= self->Size()) {
+    return scope.Close(Integer::New(0));
+  }
+  count = std::min(count, self->Size() - offset);
+  self->Erase(offset, count);
+  return scope.Close(Integer::NewFromUnsigned(count));
+}
+
 // @method: getLine
 // @param[offset]: #int line number of the line to get
 // @description: Gets a Line object from the buffer.
 Handle<Value> JSGetLine(const Arguments& args) {
   CHECK_ARGS(1);
-  GET_SELF(Buffer);
+  GET_LIVE_SELF(Buffer);
 
   Handle<Value> arg0 = args[0];
   uint32_t offset = arg0->Uint32Value();
@@ -210,15 +568,51 @@ Handle<Value> JSGetLine(const Arguments& args) {
   return scope.Close(line->ToScript());
 }
 
+// @method: getChars
+// @param[offset]: #int line number of the line to get
+// @description: Gets a read-only view of the UTF-16 character codes of a line,
+//               without creating a Line object or a string (see
+//               `Line.chars()`).
+Handle<Value> JSGetChars(const Arguments& args) {
+  CHECK_ARGS(1);
+  GET_LIVE_SELF(Buffer);
+
+  uint32_t offset = args[0]->Uint32Value();
+  if (offset >= self->Size()) {
+    return scope.Close(v8::ThrowException(v8::Exception::RangeError(
+        String::New("line out of range"))));
+  }
+  Line *line = (*self)[static_cast<size_t>(offset)];
+  ASSERT(line != nullptr);
+  return scope.Close(line->CharsView());
+}
+
+// @method: getBytes
+// @param[offset]: #int line number of the line to get
+// @description: Gets a read-only view of the UTF-8 bytes of a line (see
+//               `Line.bytes()`).
+Handle<Value> JSGetBytes(const Arguments& args) {
+  CHECK_ARGS(1);
+  GET_LIVE_SELF(Buffer);
+
+  uint32_t offset = args[0]->Uint32Value();
+  if (offset >= self->Size()) {
+    return scope.Close(v8::ThrowException(v8::Exception::RangeError(
+        String::New("line out of range"))));
+  }
+  Line *line = (*self)[static_cast<size_t>(offset)];
+  ASSERT(line != nullptr);
+  return scope.Close(line->BytesView());
+}
+
 // @method: getContents
 // @description: Returns the buffer as an array of strings.
 Handle<Value> JSGetContents(const Arguments& args) {
-  GET_SELF(Buffer);
+  GET_LIVE_SELF(Buffer);
   HandleScope scope;
   Local<Array> arr = Array::New(self->Size());
   for (size_t i = 0; i < self->Size(); i++) {
-    std::string s = (*self)[i]->ToString();
-    arr->Set(i, String::New(s.c_str(), s.size()));
+    arr->Set(i, (*self)[i]->ToV8String());
   }
   return scope.Close(arr);
 }
@@ -226,7 +620,7 @@ Handle<Value> JSGetContents(const Arguments& args) {
 // @method: getFile
 // @description: Returns the name of the file backing the buffer.
 Handle<Value> JSGetFile(const Arguments& args) {
-  GET_SELF(Buffer);
+  GET_LIVE_SELF(Buffer);
 
   HandleScope scope;
   std::string buffer_name = self->GetFilePath();
@@ -236,7 +630,7 @@ Handle<Value> JSGetFile(const Arguments& args) {
 // @method: getName
 // @description: Returns the name of the buffer.
 Handle<Value> JSGetName(const Arguments& args) {
-  GET_SELF(Buffer);
+  GET_LIVE_SELF(Buffer);
 
   HandleScope scope;
   std::string buffer_name = self->GetBufferName();
@@ -247,7 +641,7 @@ Handle<Value> JSGetName(const Arguments& args) {
 // @description: Returns the number of lines in the buffer.
 Handle<Value> JSGetLength(Local<String> property, const AccessorInfo& info) {
   HandleScope scope;
-  ACCESSOR_GET_SELF(Buffer);
+  ACCESSOR_GET_LIVE_SELF(Buffer);
   return scope.Close(Integer::New(self->Size()));
 }
 
@@ -261,12 +655,137 @@ void JSSetLength(Local<String> property, Local<Value> value,
 }
 */
 
+// @method: lineDown
+// @param[line]: #int a line number
+// @param[count]: #int the number of lines to move
+// @description: Returns the line number count lines below a line, stopping at
+//               the last line.
+Handle<Value> JSLineDown(const Arguments& args) {
+  CHECK_ARGS(2);
+  GET_LIVE_SELF(Buffer);
+
+  size_t line = static_cast<size_t>(args[0]->Uint32Value());
+  size_t count = static_cast<size_t>(args[1]->Uint32Value());
+  return scope.Close(Integer::NewFromUnsigned(self->LineDown(line, count)));
+}
+
+// @method: lineUp
+// @param[line]: #int a line number
+// @param[count]: #int the number of lines to move
+// @description: Returns the line number count lines above a line, stopping at
+//               the first line.
+Handle<Value> JSLineUp(const Arguments& args) {
+  CHECK_ARGS(2);
+  GET_LIVE_SELF(Buffer);
+
+  size_t line = static_cast<size_t>(args[0]->Uint32Value());
+  size_t count = static_cast<size_t>(args[1]->Uint32Value());
+  return scope.Close(Integer::NewFromUnsigned(self->LineUp(line, count)));
+}
+
+// @method: gotoLine
+// @param[line]: #int a line number
+// @description: Returns the line number, or the last line's if there's no
+//               such line.
+Handle<Value> JSGotoLine(const Arguments& args) {
+  CHECK_ARGS(1);
+  GET_LIVE_SELF(Buffer);
+
+  size_t line = static_cast<size_t>(args[0]->Uint32Value());
+  return scope.Close(Integer::NewFromUnsigned(self->GotoLine(line)));
+}
+
+// @method: lineStart
+// @param[line]: #int a line number
+// @description: Returns the column of the first non-blank character in a
+//               line, like vi's `^`.
+Handle<Value> JSLineStart(const Arguments& args) {
+  CHECK_ARGS(1);
+  GET_LIVE_SELF(Buffer);
+
+  size_t line = static_cast<size_t>(args[0]->Uint32Value());
+  return scope.Close(Integer::NewFromUnsigned(self->LineStart(line)));
+}
+
+// @method: lineEnd
+// @param[line]: #int the line to start from
+// @param[count]: #int the count (2 is the end of the next line, and so on)
+// @description: Returns the `line` and `column` of the last character of the
+//               line count - 1 lines down, like vi's `$`.
+Handle<Value> JSLineEnd(const Arguments& args) {
+  CHECK_ARGS(2);
+  GET_LIVE_SELF(Buffer);
+
+  std::pair<size_t, size_t> pos = self->LineEnd(
+      static_cast<size_t>(args[0]->Uint32Value()),
+      static_cast<size_t>(args[1]->Uint32Value()));
+  return scope.Close(PositionToScript(pos));
+}
+
+// @method: wordForward
+// @param[line]: #int the line to start from
+// @param[column]: #int the column to start from
+// @param[count]: #int the number of words to move
+// @description: Returns the `line` and `column` of the start of the count'th
+//               next word, like vi's `w`.
+Handle<Value> JSWordForward(const Arguments& args) {
+  CHECK_ARGS(3);
+  GET_LIVE_SELF(Buffer);
+
+  std::pair<size_t, size_t> pos = self->WordForward(
+      static_cast<size_t>(args[0]->Uint32Value()),
+      static_cast<size_t>(args[1]->Uint32Value()),
+      static_cast<size_t>(args[2]->Uint32Value()));
+  return scope.Close(PositionToScript(pos));
+}
+
+// @method: wordBackward
+// @param[line]: #int the line to start from
+// @param[column]: #int the column to start from
+// @param[count]: #int the number of words to move
+// @description: Returns the `line` and `column` of the start of the count'th
+//               previous word, like vi's `b`.
+Handle<Value> JSWordBackward(const Arguments& args) {
+  CHECK_ARGS(3);
+  GET_LIVE_SELF(Buffer);
+
+  std::pair<size_t, size_t> pos = self->WordBackward(
+      static_cast<size_t>(args[0]->Uint32Value()),
+      static_cast<size_t>(args[1]->Uint32Value()),
+      static_cast<size_t>(args[2]->Uint32Value()));
+  return scope.Close(PositionToScript(pos));
+}
+
+// @method: offsetOfLine
+// @param[line]: #int a line number
+// @description: Returns the byte offset of the start of a line in the file (as
+//               it would be written by `persist()`); the offset of the line
+//               after the last line is the size of the file.
+Handle<Value> JSOffsetOfLine(const Arguments& args) {
+  CHECK_ARGS(1);
+  GET_LIVE_SELF(Buffer);
+
+  size_t line = static_cast<size_t>(args[0]->Uint32Value());
+  return scope.Close(Integer::NewFromUnsigned(self->OffsetOfLine(line)));
+}
+
+// @method: lineOfOffset
+// @param[offset]: #int a byte offset in the file
+// @description: Returns the number of the line containing a byte offset.
+Handle<Value> JSLineOfOffset(const Arguments& args) {
+  CHECK_ARGS(1);
+  GET_LIVE_SELF(Buffer);
+
+  size_t offset = static_cast<size_t>(args[0]->Uint32Value());
+  return scope.Close(Integer::NewFromUnsigned(self->LineOfOffset(offset)));
+}
+
 // @method: open
 // @param[filename]: #string The name of the file to open.
 // @description: Open a file (this method blocks).
 Handle<Value> JSOpenFile(const Arguments& args) {
   CHECK_ARGS(1);
-  GET_SELF(Buffer);
+  GET_LIVE_SELF(Buffer);
 
   String::AsciiValue filename(args[0]);
   const std::string filename_s(*filename, filename.length());
@@ -283,7 +802,7 @@ Handle<Value> JSOpenFile(const Arguments& args) {
 // @description: Persist the buffer contents to a file (this method blocks).
 Handle<Value> JSPersist(const Arguments& args) {
   CHECK_ARGS(1);
-  GET_SELF(Buffer);
+  GET_LIVE_SELF(Buffer);
 
   if (self->IsScratch()) {
     return scope.Close(Boolean::New(false));
@@ -303,14 +822,28 @@ Handle<ObjectTemplate> MakeBufferTemplate() {
   Handle<ObjectTemplate> result = ObjectTemplate::New();
   result->SetInternalFieldCount(1);
   js::AddTemplateFunction(result, "addLine", JSAddLine);
+  js::AddTemplateFunction(result, "createViewport", JSCreateViewport);
   js::AddTemplateFunction(result, "deleteLine", JSDeleteLine);
+  js::AddTemplateFunction(result, "deleteLines", JSDeleteLines);
+  js::AddTemplateFunction(result, "getBytes", JSGetBytes);
+  js::AddTemplateFunction(result, "getChars", JSGetChars);
   js::AddTemplateFunction(result, "getContents", JSGetContents);
   js::AddTemplateFunction(result, "getFile", JSGetFile);
   js::AddTemplateFunction(result, "getLine", JSGetLine);
   js::AddTemplateFunction(result, "getName", JSGetName);
+  js::AddTemplateFunction(result, "gotoLine", JSGotoLine);
+  js::AddTemplateFunction(result, "insertText", JSInsertText);
   js::AddTemplateAccessor(result, "length", JSGetLength, nullptr);
+  js::AddTemplateFunction(result, "lineDown", JSLineDown);
+  js::AddTemplateFunction(result, "lineEnd", JSLineEnd);
+  js::AddTemplateFunction(result, "lineOfOffset", JSLineOfOffset);
+  js::AddTemplateFunction(result, "lineStart", JSLineStart);
+  js::AddTemplateFunction(result, "lineUp", JSLineUp);
+  js::AddTemplateFunction(result, "offsetOfLine", JSOffsetOfLine);
   js::AddTemplateFunction(result, "open", JSOpenFile);
   js::AddTemplateFunction(result, "persist", JSPersist);
+  js::AddTemplateFunction(result, "wordBackward", JSWordBackward);
+  js::AddTemplateFunction(result, "wordForward", JSWordForward);
   return scope.Close(result);
 }
 }
@@ -321,9 +854,6 @@ Handle<Value> Buffer::ToScript() {
     Handle<ObjectTemplate> raw_template = MakeBufferTemplate();
     buffer_template = Persistent<ObjectTemplate>::New(raw_template);
   }
-  Handle<Object> buf = buffer_template->NewInstance();
-  ASSERT(buf->InternalFieldCount() == 1);
-  buf->SetInternalField(0, External::New(this));
-  return scope.Close(buf);
+  return scope.Close(wrapper_.Wrap(buffer_template, this));
 }
 }
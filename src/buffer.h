@@ -6,16 +6,40 @@
 
 #include <v8.h>
 
+#include <algorithm>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "./embeddable.h"
 #include "./line.h"
+#include "./line_tree.h"
 
 using v8::Handle;
 using v8::Value;
 
 namespace e {
-class Buffer {
+// Interface for objects that want to know about changes to a buffer (e.g. to
+// redraw the parts of the screen showing it). Line numbers are the ones in
+// effect after the change for insertions, and before it for erasures.
+class BufferObserver {
+ public:
+  virtual ~BufferObserver() {}
+
+  // Called after count lines were inserted starting at line first
+  virtual void LinesInserted(size_t first, size_t count) = 0;
+
+  // Called after count lines were erased starting at line first
+  virtual void LinesErased(size_t first, size_t count) = 0;
+
+  // Called just before the contents of lines are modified
+  virtual void LinesModified(size_t first, size_t count) = 0;
+
+  // Called when the buffer is being destroyed
+  virtual void BufferDeleted() = 0;
+};
+
+class Buffer : public LineObserver {
  public:
   // constructors
   explicit Buffer(const std::string &name, bool scratch = true);
@@ -39,8 +63,12 @@ class Buffer {
 
   // append a line to the buffer
   inline void AppendLine(const std::string &s) {
-    Line *l = new Line(s);
-    lines_.Insert(Size(), l);
+    AppendLine(s.data(), s.size());
+  }
+
+  // append a line, given its UTF-8 contents
+  inline void AppendLine(const char *data, size_t length) {
+    InsertLine(Size(), new Line(data, length));
   }
 
   inline Line* operator[](size_t offset) { return lines_[offset]; }
@@ -48,8 +76,71 @@ class Buffer {
   // insert a line at some offset
   Line* Insert(size_t, const std::string &);
 
-  // erase a line at some offset
-  void Erase(size_t);
+  // erase count lines starting at some offset, all at once
+  void Erase(size_t offset, size_t count = 1);
+
+  // Insert text at a position in the buffer, splitting it into lines at each
+  // line break ("\n", "\r" or "\r\n"). This is done in one pass, and
+  // inserts all of the new lines at once. Returns the position just after the
+  // end of the inserted text, as a (line, column) pair.
+  std::pair<size_t, size_t> InsertText(size_t line, size_t column,
+                                       const uint16_t *text, size_t length);
+
+  // Get the byte offset of the start of a line in the UTF-8 contents of the
+  // buffer (i.e. the file as it would be written by Persist()). Passing Size()
+  // gives the size of the whole buffer.
+  size_t OffsetOfLine(size_t line);
+
+  // Get the position of a line in the buffer, in O(log n)
+  inline size_t IndexOf(const Line *line) const {
+    return tree_.PositionOf(line->Node());
+  }
+
+  // Get the line containing a byte offset; offsets past the end of the buffer
+  // are in the last line.
+  size_t LineOfOffset(size_t offset);
+
+  // Motions, which give where the cursor ends up after moving count times
+  // (stopping at the start or end of the buffer, or at line 0 if the buffer
+  // is empty). Moving by lines takes constant time, whatever the count.
+  inline size_t LineDown(size_t line, size_t count) const {
+    if (Size() == 0) {
+      return 0;
+    }
+    const size_t last = Size() - 1;
+    return line >= last ? last : line + std::min(count, last - line);
+  }
+  inline size_t LineUp(size_t line, size_t count) const {
+    return line - std::min(count, line);
+  }
+
+  // Go to a line (counting from 0), stopping at the last line
+  inline size_t GotoLine(size_t line) const {
+    return Size() == 0 ? 0 : std::min(line, Size() - 1);
+  }
+
+  // The column of the first non-blank character in a line (like vi's ^), or
+  // the last column if the line is blank
+  size_t LineStart(size_t line);
+
+  // The last column of the line count - 1 lines down (like vi's $)
+  std::pair<size_t, size_t> LineEnd(size_t line, size_t count);
+
+  // Move to the start of the next (or previous) word, like vi's w (or b). A
+  // word is a run of letters, digits and underscores, or a run of other
+  // non-blank characters; an empty line is also a word. Positions are
+  // (line, column) pairs.
+  std::pair<size_t, size_t> WordForward(size_t line, size_t column,
+                                        size_t count);
+  std::pair<size_t, size_t> WordBackward(size_t line, size_t column,
+                                         size_t count);
+
+  // Register or unregister an object to be told about changes to the buffer
+  void AddObserver(BufferObserver *observer);
+  void RemoveObserver(BufferObserver *observer);
+
+  // LineObserver implementation
+  virtual void LineChanged(Line *line);
 
   // is this a scratch buffer?
   bool IsScratch() { return scratch_; }
@@ -61,6 +152,21 @@ class Buffer {
   std::string name_;
   bool scratch_;
   Zipper<Line *> lines_;
+  ScriptWrapper wrapper_;
+
+  // The lines weighted by their byte length (including the newline), for
+  // finding line numbers and offsets; inserting or erasing lines updates it
+  // in O(log n)
+  LineTree tree_;
+
+  // Lines that have been modified since the offsets were last updated (their
+  // new lengths aren't known when they're modified)
+  std::vector<Line *> changed_lines_;
+
+  std::vector<BufferObserver *> observers_;
+
+  void InsertLine(size_t offset, Line *line);
+  void UpdateOffsets();
 };
 }
 
@@ -4,10 +4,30 @@
 #include "./curses_low_level.h"
 
 #include <curses.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 
 #include "./assert.h"
 
+namespace {
+std::atomic<uint64_t> terminal_bytes_written(0);
+
+// where the screen is drawn: standard output, or /dev/null when headless
+int terminal_fd = STDOUT_FILENO;
+
+void WriteTerminal(const char *s) {
+  fflush(stdout);
+  ssize_t n = write(terminal_fd, s, strlen(s));
+  if (n > 0) {
+    e::CountTerminalBytes(static_cast<size_t>(n));
+  }
+}
+}
+
 namespace e {
 
 bool is_initialized = false;
@@ -24,13 +44,47 @@ void InitializeCurses() {
     raw();  // read characters one at a time, and allow Ctrl-C, Ctl-Z, etc.
     set_escdelay(25);  // reduce ESCDELAY to 25ms (like vim)
 
+    // turn on bracketed paste mode, so that pastes can be told apart from
+    // typing (terminals that don't support it ignore this)
+    WriteTerminal("\x1b[?2004h");
+
     ASSERT(atexit(EndCurses) == 0);
   }
 }
 
+void InitializeHeadless(int rows, int cols) {
+  // ncurses takes the size of the screen from the environment when it can't
+  // get it from the terminal
+  char value[16];
+  snprintf(value, sizeof(value), "%d", rows);
+  setenv("LINES", value, 1);
+  snprintf(value, sizeof(value), "%d", cols);
+  setenv("COLUMNS", value, 1);
+
+  FILE *out = fopen("/dev/null", "w");
+  ASSERT(out != nullptr);
+  terminal_fd = fileno(out);
+  SCREEN *screen = newterm(const_cast<char *>("xterm-256color"), out, stdin);
+  ASSERT(screen != nullptr);
+  set_term(screen);
+}
+
+int TerminalFd() {
+  return terminal_fd;
+}
+
+void CountTerminalBytes(size_t count) {
+  terminal_bytes_written.fetch_add(count, std::memory_order_relaxed);
+}
+
+uint64_t TerminalBytesWritten() {
+  return terminal_bytes_written.load(std::memory_order_relaxed);
+}
+
 void EndCurses() {
   if (is_initialized) {
     is_initialized = false;
+    WriteTerminal("\x1b[?2004l");
     endwin();
   }
 }
@@ -10,9 +10,29 @@
 #ifndef SRC_CURSES_LOW_LEVEL_H_
 #define SRC_CURSES_LOW_LEVEL_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 namespace e {
 void InitializeCurses();
 void EndCurses();
+
+// Set up curses without a terminal (for tests and benchmarks): the screen is
+// rows by cols, input is read from standard input, and output goes to
+// /dev/null. This is used instead of initscr(), before InitializeCurses().
+void InitializeHeadless(int rows, int cols);
+
+// The file descriptor the screen is drawn to
+int TerminalFd();
+
+// The number of bytes the editor has written to the terminal (i.e.
+// TerminalFd()) so far. Only output that goes through CountTerminalBytes() is
+// counted, which is everything drawn by the direct output backend; what
+// curses draws itself isn't.
+uint64_t TerminalBytesWritten();
+
+// Count bytes written directly to TerminalFd() (i.e. not through curses)
+void CountTerminalBytes(size_t count);
 }
 
 #endif  // SRC_CURSES_LOW_LEVEL_H_
@@ -5,8 +5,12 @@
 
 #include <boost/asio.hpp>
 #include <boost/asio/posix/stream_descriptor.hpp>
+#include <errno.h>
+#include <poll.h>
 #include <term.h>
 #include <termios.h>
+#include <time.h>
+#include <unistd.h>
 #include <v8.h>
 #include <wchar.h>
 
@@ -23,17 +27,27 @@
 #include <curses.h>  // NOLINT
 #endif  // USE_NCURSESW
 
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <functional>
+#include <string>
+#include <vector>
 
 #include "./assert.h"
 #include "./curses_low_level.h"
 #include "./flags.h"
 #include "./io_service.h"
 #include "./js_curses_window.h"
+#include "./key_record.h"
 #include "./keycode.h"
+#include "./latency.h"
 #include "./logging.h"
+#include "./term_output.h"
 
 using v8::Context;
+using v8::HeapStatistics;
 using v8::Local;
 using v8::String;
 using v8::Object;
@@ -43,30 +57,122 @@ namespace {
 bool UseAsio() {
   return !vm.count("without-boost-asio");
 }
+
+uint64_t MonotonicMillis() {
+  timespec ts;
+  ASSERT(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+// The sequence terminals send at the start of a bracketed paste
+const char kPasteStart[] = "\x1b[200~";
+const size_t kPasteStartLength = sizeof(kPasteStart) - 1;
+
+// How long to wait for the rest of a paste's start sequence once the input
+// has been drained, before handling what was read (e.g. a lone escape) as keys
+const int kPasteStartTimeoutMillis = 25;
+
+// Is there input waiting to be read from the terminal?
+bool InputPending() {
+  pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+  return poll(&pfd, 1, 0) > 0;
+}
+
+// Write the text on the screen to the --dump-screen file
+void DumpScreen() {
+  if (direct_output == nullptr) {
+    return;
+  }
+  direct_output->Wait();
+  const std::string &path = vm["dump-screen"].as<std::string>();
+  FILE *f = fopen(path.c_str(), "w");
+  if (f == nullptr) {
+    LOG(ERROR, "failed to open %s: %s", path.c_str(), strerror(errno));
+    return;
+  }
+  for (const std::string &row : direct_output->ScreenText()) {
+    fprintf(f, "%s\n", row.c_str());
+  }
+  fclose(f);
+}
+
+// The report from --replay, which is printed once the terminal has been
+// restored
+std::vector<std::string> replay_report;
+
+void PrintReplayReport() {
+  for (const std::string &line : replay_report) {
+    fprintf(stderr, "%s\n", line.c_str());
+  }
+}
 }
 
 CursesWindow::CursesWindow(const std::vector<std::string> &scripts,
                            const std::vector<std::string> &files)
     :state_(scripts, files), args_(files),
-     term_in_(io_service) {
+     term_in_(io_service), input_(nullptr), burst_start_(0),
+     frame_deadline_(0),
+     in_paste_(false), paste_matched_(0), paste_timer_(io_service) {
 }
 
 void CursesWindow::Initialize() {
-  WINDOW *window = initscr();
+  frame_deadline_ = vm["frame-deadline"].as<int>();
+  if (vm.count("record")) {
+    const std::string &path = vm["record"].as<std::string>();
+    recorder_.reset(KeyRecorder::Open(path));
+    if (!recorder_) {
+      fprintf(stderr, "failed to create %s: %s\n", path.c_str(),
+              strerror(errno));
+      exit(1);
+    }
+  } else if (vm.count("replay")) {
+    const std::string &path = vm["replay"].as<std::string>();
+    replayer_.reset(KeyReplayer::Open(path));
+    if (!replayer_) {
+      fprintf(stderr, "failed to load the recording %s\n", path.c_str());
+      exit(1);
+    }
+    LOG(INFO, "replaying %zd keys from %s", replayer_->NumKeys(),
+        path.c_str());
+    ASSERT(atexit(PrintReplayReport) == 0);  // runs after EndCurses()
+  }
+
+  WINDOW *window;
+  if (vm.count("headless")) {
+    int rows, cols;
+    sscanf(vm["screen-size"].as<std::string>().c_str(), "%dx%d", &cols,
+           &rows);
+    InitializeHeadless(rows, cols);
+    window = stdscr;
+  } else {
+    window = initscr();
+  }
 
   InitializeCurses();
 
-  keypad(window, TRUE);
   clearok(window, TRUE);
-  notimeout(window, TRUE);
+  input_ = window;
+  if (vm.count("direct-output") || vm.count("headless")) {
+    // Pads are never refreshed by wgetch(), so reading from one leaves the
+    // terminal alone.
+    direct_output = new TermOutput(TerminalFd());
+    ASSERT(atexit(EndDirectOutput) == 0);  // runs before EndCurses()
+    if (vm.count("dump-screen")) {
+      ASSERT(atexit(DumpScreen) == 0);  // runs before EndDirectOutput()
+    }
+    input_ = newpad(1, 1);
+  }
+  keypad(input_, TRUE);
+  notimeout(input_, TRUE);
   if (UseAsio()) {
-    nodelay(window, true);
+    nodelay(input_, true);
   }
 
   struct termios ttystate;
-  tcgetattr(STDIN_FILENO, &ttystate);
-  ttystate.c_iflag &= ~IXON;  // allow capturs Ctrl-Q/Ctrl-S
-  tcsetattr(0, TCSANOW, &ttystate);
+  if (tcgetattr(STDIN_FILENO, &ttystate) == 0) {
+    ttystate.c_iflag &= ~IXON;  // allow capturs Ctrl-Q/Ctrl-S
+    tcsetattr(0, TCSANOW, &ttystate);
+  }
 
   if (UseAsio()) {
     term_in_.assign(STDIN_FILENO);
@@ -88,51 +194,259 @@ bool CursesWindow::HandleKey(KeyCode *keycode) {
   return state_.HandleKey(keycode);
 }
 
+// Hand the keys read since the last batch to scripts, if there are any
+bool CursesWindow::HandleBatch() {
+  if (batch_.empty()) {
+    return true;
+  }
+  const uint64_t start = replayer_ ? MonotonicNanos() : 0;
+  const bool keep_going = state_.HandleKeyBatch(batch_);
+  if (replayer_) {
+    const uint64_t per_key = (MonotonicNanos() - start) / batch_.size();
+    for (size_t i = 0; i < batch_.size(); i++) {
+      replay_stats_.AddKey(per_key);
+    }
+  }
+  batch_.clear();
+  return keep_going;
+}
+
+// Update the screen, after handling any keys waiting in the batch
+bool CursesWindow::Flush() {
+  return HandleBatch() && state_.Flush();
+}
+
 void CursesWindow::OnRead(const boost::system::error_code& error,
                            std::size_t bytes_transferred) {
   if (error) {
     LOG(FATAL, "boot::asio error ", error.message().c_str());
   } else {
+    latency.InputRead();
     InnerOnRead();
   }
 }
 
+bool CursesWindow::ReadInput(wint_t *wch, bool *is_keycode) {
+  if (replayer_) {
+    return replayer_->Next(wch, is_keycode);
+  }
+#ifdef USE_NCURSESW
+  int ret = wget_wch(input_, wch);
+  if (ret == ERR) {
+    return false;
+  }
+  *is_keycode = (ret == KEY_CODE_YES);
+#else
+  int ch = wgetch(input_);
+  if (ch == ERR) {
+    return false;
+  }
+  *wch = static_cast<wint_t>(ch);
+  *is_keycode = (*wch >= 256);
+#endif
+  if (recorder_) {
+    recorder_->Add(*wch, *is_keycode);
+  }
+  return true;
+}
+
+// Is there input that can be read without blocking?
+bool CursesWindow::InputWaiting() {
+  return replayer_ ? replayer_->Pending() : InputPending();
+}
+
+// Match a key against the sequence that starts a bracketed paste. Returns true
+// if the key continues the sequence, in which case it's held (and in_paste_ is
+// set once the sequence is complete); otherwise the keys held so far aren't
+// the start of a paste, and should be released.
+bool CursesWindow::MatchPasteStart(wint_t wch, bool is_keycode) {
+  if (is_keycode || wch != static_cast<wint_t>(kPasteStart[paste_matched_])) {
+    return false;
+  }
+  paste_matched_++;
+  if (paste_matched_ == kPasteStartLength) {
+    paste_matched_ = 0;
+    in_paste_ = true;
+    paste_.clear();
+  }
+  return true;
+}
+
+// Handle the keys held by MatchPasteStart() as ordinary keys
+bool CursesWindow::ReleasePasteStart() {
+  const size_t held = paste_matched_;
+  paste_matched_ = 0;
+  for (size_t i = 0; i < held; i++) {
+    if (!HandleInput(static_cast<wint_t>(kPasteStart[i]), false)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The rest of a paste's start sequence didn't come in time, so what was held
+// was typed (e.g. escape on its own)
+void CursesWindow::OnPasteTimeout(const boost::system::error_code& error) {
+  if (error || paste_matched_ == 0) {
+    return;  // cancelled, because more input came in
+  }
+  if (!ReleasePasteStart() || !Flush()) {
+    io_service.stop();
+  }
+}
+
+// Add a character to the text being pasted, and finish the paste if the text
+// now ends with the "ESC [ 2 0 1 ~" sequence.
+void CursesWindow::AddPasteInput(wint_t wch) {
+  static const uint16_t kPasteEnd[] = {27, '[', '2', '0', '1', '~'};
+  static const size_t kPasteEndLength = sizeof(kPasteEnd) / sizeof(uint16_t);
+  if (wch >= 0x10000) {
+    wch -= 0x10000;
+    paste_.push_back(static_cast<uint16_t>(0xD800 | (wch >> 10)));
+    paste_.push_back(static_cast<uint16_t>(0xDC00 | (wch & 0x3FF)));
+  } else {
+    paste_.push_back(static_cast<uint16_t>(wch));
+  }
+  if (wch == '~' && paste_.size() >= kPasteEndLength &&
+      std::equal(kPasteEnd, kPasteEnd + kPasteEndLength,
+                 paste_.end() - kPasteEndLength)) {
+    paste_.resize(paste_.size() - kPasteEndLength);
+    in_paste_ = false;
+    LOG(DBG, "pasted %zd characters", paste_.size());
+    if (!state_.FlushPending()) {
+      burst_start_ = MonotonicMillis();
+    }
+    state_.HandlePaste(paste_.data(), paste_.size());
+    paste_.clear();
+  }
+}
+
+// Handle a key read from the terminal, or hold it in the batch
+bool CursesWindow::HandleInput(wint_t wch, bool is_keycode) {
+  KeyCode *keycode = CursesToKeycode(wch, is_keycode);
+  if (keycode->IsPrintable()) {
+    LOG(DBG, "read '%c' from keyboard (code %d)",
+        static_cast<char>(wch), wch);
+  } else {
+    LOG(DBG, "read code %d from keyboard", wch);
+  }
+
+  if (!state_.FlushPending() && batch_.empty()) {
+    burst_start_ = MonotonicMillis();
+  }
+  if (state_.WantsKeyBatches()) {
+    // the batch is handled when the screen is next updated
+    batch_.push_back(keycode);
+  } else {
+    const uint64_t key_start = replayer_ ? MonotonicNanos() : 0;
+    const bool keep_going = HandleKey(keycode);
+    if (replayer_) {
+      replay_stats_.AddKey(MonotonicNanos() - key_start);
+    }
+    if (!keep_going) {
+      return false;
+    }
+  }
+  if (MonotonicMillis() - burst_start_ >= frame_deadline_) {
+    return Flush();
+  }
+  return true;
+}
+
 bool CursesWindow::InnerOnRead() {
   // there should be at least one byte to read (and possibly more); keep reading
   // bytes until getch() returns ERR
+  //
+  // The screen is only updated once the input has been drained (or the frame
+  // deadline has passed), so a burst of input causes a single screen update.
+  const uint64_t burst_nanos = MonotonicNanos();
   bool keep_going = true;
+  bool at_eof = false;
+  paste_timer_.cancel();
   while (true) {
-#ifdef USE_NCURSESW
-    wint_t wch;
-    int ret = get_wch(&wch);
-    if (ret == ERR) {
-      break;
+    if (paste_matched_ > 0 && !UseAsio() && !replayer_ && !InputPending()) {
+      // the read below would block, so don't wait for the rest of the paste
+      // sequence
+      keep_going = ReleasePasteStart();
+      if (!keep_going) {
+        break;
+      }
     }
-    bool is_keycode = (ret == KEY_CODE_YES);
-#else
-    int ch = static_cast<wint_t>(getch());
-    if (ch == ERR) {
+    if (!UseAsio() && !replayer_ &&
+        (state_.FlushPending() || !batch_.empty()) && !InputPending()) {
+      // the read below would block, so update the screen first
+      keep_going = Flush();
+      if (!keep_going) {
+        break;
+      }
+    }
+    wint_t wch;
+    bool is_keycode;
+    if (!ReadInput(&wch, &is_keycode)) {
+      // A headless session's input is usually a file or a pipe, and the
+      // session ends once all of it has been read.
+      at_eof = vm.count("headless") && !replayer_ && InputPending();
+      if (at_eof) {
+        keep_going = ReleasePasteStart();
+      }
       break;
     }
-    wint_t wch = static_cast<wint_t>(ch);
-    bool is_keycode = (wch >= 256);
-#endif
-    KeyCode *keycode = CursesToKeycode(wch, is_keycode);
-    if (keycode->IsPrintable()) {
-      LOG(DBG, "read '%c' from keyboard (code %d)",
-          static_cast<char>(wch), wch);
-    } else {
-      LOG(DBG, "read code %d from keyboard", wch);
+    latency.InputRead();
+    if (in_paste_) {
+      if (!is_keycode) {
+        AddPasteInput(wch);
+      }
+      continue;
     }
 
-    keep_going = HandleKey(keycode);
+    bool matched = MatchPasteStart(wch, is_keycode);
+    if (!matched && paste_matched_ > 0) {
+      keep_going = ReleasePasteStart();
+      if (!keep_going) {
+        break;
+      }
+      matched = MatchPasteStart(wch, is_keycode);  // e.g. another escape
+    }
+    if (matched) {
+      if (in_paste_) {
+        // the keys typed before the paste are handled before it
+        keep_going = HandleBatch();
+        if (!keep_going) {
+          break;
+        }
+      }
+      continue;
+    }
+    keep_going = HandleInput(wch, is_keycode);
     if (!keep_going) {
       break;
     }
   }
+  if (keep_going) {
+    keep_going = Flush();
+  }
+  if (replayer_) {
+    replay_stats_.AddBurst(MonotonicNanos() - burst_nanos);
+  }
+  if (recorder_) {
+    recorder_->EndBurst();
+  }
+  if (at_eof) {
+    keep_going = false;
+    io_service.stop();
+  }
+  if (keep_going && paste_matched_ > 0) {
+    // the rest of the paste sequence may be in the next read
+    paste_timer_.expires_from_now(
+        boost::posix_time::milliseconds(kPasteStartTimeoutMillis));
+    paste_timer_.async_wait(std::bind(&CursesWindow::OnPasteTimeout, this,
+                                      std::placeholders::_1));
+  }
   if (keep_going) {
     v8::V8::IdleNotification();  // tell v8 we're idle (it may want to GC)
-    EstablishReadLoop();
+    if (!replayer_) {
+      EstablishReadLoop();
+    }
   }
   return keep_going;
 }
@@ -154,6 +468,10 @@ void CursesWindow::InnerLoop() {
 
   state_.GetListener()->Dispatch("load");
 
+  if (replayer_) {
+    Replay();
+    return;
+  }
   LOG(INFO, "waiting for keypresses...");
   if (UseAsio()) {
     EstablishReadLoop();
@@ -162,4 +480,30 @@ void CursesWindow::InnerLoop() {
     while (InnerOnRead()) { }
   }
 }
+
+// Replay the recording given with --replay. Each burst goes through
+// InnerOnRead() just as if it had been read from the terminal, so that it's
+// handled (and the screen is updated) the same way as when it was recorded.
+// Timers and other events that are due are run between bursts.
+void CursesWindow::Replay() {
+  HeapStatistics heap;
+  v8::V8::GetHeapStatistics(&heap);
+  replay_stats_.Start(heap.used_heap_size(), TerminalBytesWritten());
+  const bool realtime = !vm.count("replay-fast");
+  while (replayer_->StartBurst(realtime)) {
+    io_service.poll();
+    if (!InnerOnRead()) {
+      break;
+    }
+  }
+  if (direct_output != nullptr) {
+    direct_output->Wait();
+  }
+  v8::V8::GetHeapStatistics(&heap);
+  replay_stats_.Finish(heap.used_heap_size(), TerminalBytesWritten());
+  replay_report = replay_stats_.Report();
+  for (const std::string &line : replay_report) {
+    LOG(INFO, "%s", line.c_str());
+  }
+}
 }
@@ -6,10 +6,15 @@
 
 #include <boost/asio.hpp>
 #include <boost/asio/posix/stream_descriptor.hpp>
+#include <curses.h>
+#include <stdint.h>
+#include <wchar.h>
 
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "./key_record.h"
 #include "./keycode.h"
 #include "./state.h"
 
@@ -25,11 +30,52 @@ class CursesWindow {
   std::vector<std::string> args_;
   boost::asio::posix::stream_descriptor term_in_;
 
+  // the window input is read from; this is stdscr, unless ncurses isn't
+  // drawing the screen (reading from stdscr would make ncurses refresh it)
+  WINDOW *input_;
+
+  // when the first key handled since the last screen update was read (in
+  // milliseconds, from a monotonic clock)
+  uint64_t burst_start_;
+
+  // how long a burst of input can go before the screen is updated (in
+  // milliseconds), from --frame-deadline
+  uint64_t frame_deadline_;
+
+  // the text of the bracketed paste being read, if in_paste_ is true
+  bool in_paste_;
+  std::vector<uint16_t> paste_;
+
+  // how much of the sequence that starts a bracketed paste has been read;
+  // those keys are held until it's clear whether they start a paste (the
+  // sequence can be split between reads), or until paste_timer_ fires
+  size_t paste_matched_;
+  boost::asio::deadline_timer paste_timer_;
+
+  // keys read but not yet handled, if keys are being handled in batches
+  std::vector<KeyCode *> batch_;
+
+  // with --record, the recording being made; with --replay, the recording
+  // being replayed (instead of reading the terminal) and its measurements
+  std::unique_ptr<KeyRecorder> recorder_;
+  std::unique_ptr<KeyReplayer> replayer_;
+  ReplayStats replay_stats_;
+
   void InnerLoop();
+  void Replay();
 
   void OnRead(const boost::system::error_code&, std::size_t);
   bool InnerOnRead();
+  bool ReadInput(wint_t *wch, bool *is_keycode);
+  bool InputWaiting();
+  bool MatchPasteStart(wint_t wch, bool is_keycode);
+  bool ReleasePasteStart();
+  void OnPasteTimeout(const boost::system::error_code&);
+  void AddPasteInput(wint_t wch);
+  bool HandleInput(wint_t wch, bool is_keycode);
   bool HandleKey(KeyCode *k);
+  bool HandleBatch();
+  bool Flush();
   void EstablishReadLoop();
 };
 }
@@ -22,6 +22,7 @@ using v8::ObjectTemplate;
 using v8::Persistent;
 using v8::String;
 using v8::Value;
+using v8::WeakReferenceCallback;
 
 namespace e {
 template<typename T> T* Unwrap(Handle<Object> holder, int field = 0) {
@@ -49,6 +50,64 @@ template<typename T, typename A> T* Unwrap(const A &args, int field = 0) {
 
 #define GET_SELF(tp) GET_SELF2(args, tp)
 #define ACCESSOR_GET_SELF(tp) GET_SELF2(info, tp)
+
+// Like GET_SELF, but throws an exception if the wrapped object has been
+// neutered (i.e. the native object it referred to was deleted).
+#define GET_LIVE_SELF2(a, tp) GET_SELF2(a, tp);                  \
+  if (self == nullptr) {                                         \
+    return v8::ThrowException(v8::Exception::ReferenceError(     \
+        v8::String::New(#tp " has been deleted")));              \
+  }
+
+#define GET_LIVE_SELF(tp) GET_LIVE_SELF2(args, tp)
+#define ACCESSOR_GET_LIVE_SELF(tp) GET_LIVE_SELF2(info, tp)
+
+// Holds the JS wrapper object for a native object, so that the same native
+// object is always represented by the same JS object. The wrapper is held
+// weakly: if scripts drop all references to it, it's garbage collected and a
+// new one is created the next time it's needed. When the native object is
+// destroyed the wrapper is neutered, so calls made through stale references
+// fail cleanly (see GET_LIVE_SELF) instead of following a dangling pointer.
+class ScriptWrapper {
+ public:
+  ScriptWrapper() {}
+  ~ScriptWrapper() { Neuter(); }
+
+  // Get the wrapper for obj, creating it from templ if necessary.
+  Local<Object> Wrap(Handle<ObjectTemplate> templ, void *obj) {
+    HandleScope scope;
+    if (handle_.IsEmpty()) {
+      Local<Object> wrapper = templ->NewInstance();
+      wrapper->SetInternalField(0, External::New(obj));
+      handle_ = Persistent<Object>::New(wrapper);
+      handle_.MakeWeak(this, &ScriptWrapper::OnCollected);
+    }
+    return scope.Close(handle_);
+  }
+
+  // Detach the wrapper from the native object.
+  void Neuter() {
+    if (!handle_.IsEmpty()) {
+      HandleScope scope;
+      handle_->SetInternalField(0, External::New(nullptr));
+      handle_.ClearWeak();
+      handle_.Dispose();
+      handle_.Clear();
+    }
+  }
+
+ private:
+  Persistent<Object> handle_;
+
+  ScriptWrapper(const ScriptWrapper &);
+  ScriptWrapper& operator=(const ScriptWrapper &);
+
+  static void OnCollected(Persistent<Value> val, void *param) {
+    ScriptWrapper *self = static_cast<ScriptWrapper *>(param);
+    val.Dispose();
+    self->handle_.Clear();
+  }
+};
 }
 
 #endif  // SRC_EMBEDDABLE_H_
@@ -3,17 +3,20 @@
 
 #include "./event_listener.h"
 
+#include <algorithm>
 #include <map>
-#include <memory>
 #include <string>
 #include <vector>
 
 #include "./embeddable.h"
 #include "./js.h"
+#include "./latency.h"
+#include "./watchdog.h"
 
 using v8::Arguments;
 using v8::Context;
 using v8::External;
+using v8::Function;
 using v8::Handle;
 using v8::HandleScope;
 using v8::Integer;
@@ -24,107 +27,209 @@ using v8::String;
 using v8::Undefined;
 using v8::Value;
 
+namespace {
+// the names of the interned events, indexed by id, and the id of each name
+std::vector<std::string> event_names;
+std::map<std::string, e::EventId> event_ids;
+
+// The name a listener is profiled under
+std::string ListenerName(Handle<Object> callback, const std::string &event) {
+  Local<Value> name = callback->Get(String::NewSymbol("displayName"));
+  if ((!name->IsString() || name->ToString()->Length() == 0) &&
+      callback->IsFunction()) {
+    name = Local<Value>::New(Handle<Function>::Cast(callback)->GetName());
+  }
+  if (!name->IsString() || name->ToString()->Length() == 0) {
+    return "(anonymous " + event + " listener)";
+  }
+  return e::js::ValueToString(name);
+}
+}
+
 namespace e {
-std::vector<Persistent<Object> >& EventListener::CallbackMap(
-    const std::string &callback_name,
-    bool use_capture) {
-  if (use_capture)
-    return capture_[callback_name];
-  else
-    return bubble_[callback_name];
+EventListener::EventListener()
+    :profiling_(false) {
+}
+
+EventListener::~EventListener() {
+  for (Handlers &handlers : handlers_) {
+    for (std::vector<Handler> *list : {&handlers.capture, &handlers.bubble}) {
+      for (Handler &handler : *list) {
+        handler.object.Dispose();
+        if (!handler.callable.IsEmpty()) {
+          handler.callable.Dispose();
+        }
+      }
+    }
+  }
+}
+
+EventId EventListener::Intern(const std::string &name) {
+  auto it = event_ids.find(name);
+  if (it != event_ids.end()) {
+    return it->second;
+  }
+  const EventId id = static_cast<EventId>(event_names.size());
+  event_names.push_back(name);
+  event_ids[name] = id;
+  return id;
+}
+
+const std::string& EventListener::EventName(EventId id) {
+  return event_names[id];
+}
+
+void EventListener::SetProfiling(bool profiling) {
+  if (profiling && !profiling_) {
+    profile_.clear();
+  }
+  profiling_ = profiling;
+}
+
+std::vector<EventListener::Handler>& EventListener::HandlerList(
+    EventId id, bool use_capture) {
+  if (id >= handlers_.size()) {
+    handlers_.resize(id + 1);
+  }
+  return use_capture ? handlers_[id].capture : handlers_[id].bubble;
 }
 
 bool EventListener::Add(const std::string& callback_name,
                         Local<Object> callback,
                         bool use_capture) {
-  std::vector<Persistent<Object> > &callback_list = CallbackMap(callback_name,
-                                                                use_capture);
-  std::vector<Persistent<Object> >::iterator it;
-  for (it = callback_list.begin(); it != callback_list.end(); ++it) {
-    if ((*it) == callback) {
+  std::vector<Handler> &list = HandlerList(Intern(callback_name), use_capture);
+  for (const Handler &handler : list) {
+    if (handler.object == callback) {
       return false;
     }
   }
-  Persistent<Object> callback_obj = Persistent<Object>::New(callback);
-  callback_list.push_back(callback_obj);
+  Handler handler;
+  handler.object = Persistent<Object>::New(callback);
+  if (callback->IsCallable()) {
+    handler.callable = Persistent<Object>::New(callback);
+  }
+  list.push_back(handler);
   return true;
 }
 
 bool EventListener::Remove(const std::string &callback_name,
                            Local<Object> callback,
                            bool use_capture) {
-  std::vector<Persistent<Object> > &callback_list = CallbackMap(callback_name,
-                                                                use_capture);
-  std::vector<Persistent<Object> >::iterator it;
-  for (it = callback_list.begin(); it != callback_list.end(); ++it) {
-    if (*it == callback) {
-      it->Dispose();
-      callback_list.erase(it);
+  std::vector<Handler> &list = HandlerList(Intern(callback_name), use_capture);
+  for (auto it = list.begin(); it != list.end(); ++it) {
+    if (it->object == callback) {
+      it->object.Dispose();
+      if (!it->callable.IsEmpty()) {
+        it->callable.Dispose();
+      }
+      list.erase(it);
       return true;
     }
   }
   return false;
 }
 
-bool EventListener::CallHandler(Handle<Value> h,
-                                Handle<Object> this_argument,
-                                size_t argc,
-                                Handle<Value> argv[]) {
-  HandleScope scope;
-  if (h->IsObject()) {
-    Handle<Object> o = Handle<Object>::Cast(h);
-    if (o->IsCallable()) {
-      o->CallAsFunction(this_argument, argc, argv);
-      return true;
+EventListener::Handler* EventListener::FindHandler(EventId id,
+                                                  bool use_capture,
+                                                  size_t hint,
+                                                  Handle<Object> object) {
+  std::vector<Handler> &list = HandlerList(id, use_capture);
+  if (hint < list.size() && list[hint].object == object) {
+    return &list[hint];
+  }
+  for (Handler &handler : list) {
+    if (handler.object == object) {
+      return &handler;
     }
+  }
+  return nullptr;
+}
+
+// Call each handler in a list. Handlers can add and remove handlers, so this
+// goes through a snapshot of the list taken as local handles (which stay
+// valid even if a handler is removed and disposed of while it's running), and
+// skips the handlers that have been removed by the time they'd be called.
+// Handlers added during the dispatch aren't called until the next one.
+void EventListener::CallHandlers(EventId id, bool use_capture,
+                                 Handle<Object> this_argument, int argc,
+                                 Handle<Value> argv[]) {
+  std::vector<Local<Object> > objects;
+  std::vector<Local<Object> > callables;
+  {
+    const std::vector<Handler> &list = HandlerList(id, use_capture);
+    objects.reserve(list.size());
+    callables.reserve(list.size());
+    for (const Handler &handler : list) {
+      objects.push_back(Local<Object>::New(handler.object));
+      callables.push_back(handler.callable.IsEmpty() ?
+                          Local<Object>() :
+                          Local<Object>::New(handler.callable));
+    }
+  }
 
-    Handle<String> handle_event_string = String::NewSymbol("handleEvent");
-    Handle<Value> handle_event = o->Get(handle_event_string);
-    if (handle_event->IsObject()) {
-      Handle<Object> handle_event_obj = Handle<Object>::Cast(handle_event);
-      if (handle_event_obj->IsCallable()) {
-        handle_event_obj->CallAsFunction(this_argument, argc, argv);
-        return false;
+  for (size_t i = 0; i < objects.size(); i++) {
+    if (FindHandler(id, use_capture, i, objects[i]) == nullptr) {
+      continue;  // removed by an earlier handler
+    }
+    Local<Object> callable = callables[i];
+    if (callable.IsEmpty()) {
+      // An object with a handleEvent() method; like the DOM, the method is
+      // looked up each time, so scripts can replace it.
+      Local<Value> handle_event =
+          objects[i]->Get(String::NewSymbol("handleEvent"));
+      if (!handle_event->IsObject() ||
+          !Handle<Object>::Cast(handle_event)->IsCallable()) {
+        continue;
+      }
+      callable = Local<Object>::Cast(handle_event);
+
+      // looking up the method can run a getter, which could remove it
+      if (FindHandler(id, use_capture, i, objects[i]) == nullptr) {
+        continue;
       }
     }
+
+    if (!profiling_) {
+      callable->CallAsFunction(this_argument, argc, argv);
+    } else {
+      const uint64_t start = MonotonicNanos();
+      callable->CallAsFunction(this_argument, argc, argv);
+      const uint64_t elapsed = MonotonicNanos() - start;
+      ListenerStats &stats = profile_[ListenerName(callable, EventName(id))];
+      stats.calls++;
+      stats.total += elapsed;
+      stats.max = std::max(stats.max, elapsed);
+    }
   }
-  return false;
 }
 
 void EventListener::Dispatch(const std::string& name) {
-  Local<Object> globals = Context::GetCurrent()->Global();
-  std::vector<Handle<Value> > arguments;
-  Dispatch(name, globals, arguments);
+  Dispatch(Intern(name), Handle<Object>(), 0, nullptr);
 }
 
 void EventListener::Dispatch(const std::string& name,
                              const std::vector<Handle<Value> >& args) {
-  Local<Object> globals = Context::GetCurrent()->Global();
-  Dispatch(name, globals, args);
+  Dispatch(name, Handle<Object>(), args);
 }
 
 void EventListener::Dispatch(const std::string &name,
                              Handle<Object> this_argument,
-                             const std::vector<Handle<Value> > &arguments) {
-  std::vector<Persistent<Object> > &captures = capture_[name];
-  std::vector<Persistent<Object> > &bubbles = bubble_[name];
-
-  // build up argc and argv
-  const size_t argc = arguments.size();
-  std::unique_ptr<Handle<Value>[]> argv(new Handle<Value>[argc]);
-  int i = 0;
-  for (auto cit = arguments.begin(); cit != arguments.end(); ++cit) {
-    argv[i++] = Handle<Value>(*cit);
-  }
+                             const std::vector<Handle<Value> > &args) {
+  Dispatch(Intern(name), this_argument, static_cast<int>(args.size()),
+           const_cast<Handle<Value> *>(args.data()));
+}
 
-  // call all of the capture callbacks
-  for (auto it = captures.begin(); it != captures.end(); ++it) {
-    CallHandler(*it, this_argument, argc, argv.get());
+void EventListener::Dispatch(EventId id, Handle<Object> this_argument,
+                             int argc, Handle<Value> argv[]) {
+  if (!HasHandlers(id)) {
+    return;
   }
-
-  // call all of the bubble callbacks
-  for (auto it = bubbles.begin(); it != bubbles.end(); ++it) {
-    CallHandler(*it, this_argument, argc, argv.get());
+  HandleScope scope;
+  if (this_argument.IsEmpty()) {
+    this_argument = Context::GetCurrent()->Global();
   }
+  WatchdogScope watchdog_scope(EventName(id));
+  CallHandlers(id, true, this_argument, argc, argv);
+  CallHandlers(id, false, this_argument, argc, argv);
 }
 }
@@ -1,9 +1,17 @@
 // -*- C++ -*-
 // Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+//
+// The native event listener (which is what world.addEventListener() adds to).
+//
+// Event names are interned to small integer ids, so that dispatching an event
+// (which happens a few times per keypress) is an index into a flat array of
+// handlers rather than a map lookup. Code that dispatches an event often should
+// intern its name once, and dispatch by id.
 
 #ifndef SRC_EVENT_LISTENER_H_
 #define SRC_EVENT_LISTENER_H_
 
+#include <stdint.h>
 #include <v8.h>
 #include <map>
 #include <string>
@@ -16,21 +24,81 @@ using v8::Persistent;
 using v8::Value;
 
 namespace e {
+typedef uint32_t EventId;
+
 class EventListener {
  public:
+  // The time spent in a listener, while profiling (in nanoseconds)
+  struct ListenerStats {
+    uint64_t calls;
+    uint64_t total;
+    uint64_t max;
+  };
+
+  EventListener();
+  ~EventListener();
+
+  // Get the id for an event name (which is the same for every listener)
+  static EventId Intern(const std::string &name);
+
+  // Get the name of an interned event
+  static const std::string& EventName(EventId id);
+
   bool Add(const std::string&, Local<Object>, bool);
   bool Remove(const std::string&, Local<Object>, bool);
+
   void Dispatch(const std::string& name);
   void Dispatch(const std::string& name,
                 const std::vector<Handle<Value> >& args);
   void Dispatch(const std::string& name, Handle<Object> this_object,
                 const std::vector<Handle<Value> >& args);
+
+  // Are there any handlers for an event?
+  inline bool HasHandlers(EventId id) const {
+    return (id < handlers_.size() && (!handlers_[id].capture.empty() ||
+                                      !handlers_[id].bubble.empty()));
+  }
+
+  // Dispatch an event to the capture and then the bubble handlers, with the
+  // global object as this if this_object is empty
+  void Dispatch(EventId id, Handle<Object> this_object, int argc,
+                Handle<Value> argv[]);
+
+  // Start or stop recording the time spent in each listener; starting clears
+  // whatever was recorded before.
+  void SetProfiling(bool profiling);
+  inline bool Profiling() const { return profiling_; }
+
+  // The time spent in each listener called while profiling, keyed by the
+  // listener's displayName (or its function name)
+  inline const std::map<std::string, ListenerStats>& Profile() const {
+    return profile_;
+  }
+
  private:
-  std::map<std::string, std::vector<Persistent<Object> > > capture_;
-  std::map<std::string, std::vector<Persistent<Object> > > bubble_;
+  struct Handler {
+    Persistent<Object> object;  // what was added
+    // what's called, if what was added is callable itself (otherwise its
+    // handleEvent() method is looked up on each dispatch)
+    Persistent<Object> callable;
+  };
+  struct Handlers {
+    std::vector<Handler> capture;
+    std::vector<Handler> bubble;
+  };
+
+  std::vector<Handlers> handlers_;  // indexed by event id
+  bool profiling_;
+  std::map<std::string, ListenerStats> profile_;
+
+  std::vector<Handler>& HandlerList(EventId id, bool use_capture);
 
-  bool CallHandler(Handle<Value> h, Handle<Object>, size_t, Handle<Value>[]);
-  std::vector<Persistent<Object> >& CallbackMap(const std::string &, bool);
+  // Find the handler for an object in a list, looking at position hint first;
+  // returns nullptr if it isn't in the list
+  Handler* FindHandler(EventId id, bool use_capture, size_t hint,
+                       Handle<Object> object);
+  void CallHandlers(EventId id, bool use_capture, Handle<Object> this_object,
+                    int argc, Handle<Value> argv[]);
 };
 }
 
@@ -29,7 +29,13 @@ int ParseOptions(int argc, char **argv) {
     ("no-init-file", "do not load the init file ~/.e.js")
     ("skip-core", "skip loading any bundled \"core\" JS files")
     ("script,s", po::value<std::vector<std::string> >(),
-     "additional script file(s) to load");
+     "additional script file(s) to load")
+    ("script-soft-budget", po::value<int>()->default_value(200),
+     "log the JavaScript stack when an event handler (or timer, or script) "
+     "runs for longer than this many milliseconds (0 to disable)")
+    ("script-hard-budget", po::value<int>()->default_value(10000),
+     "terminate an event handler (or timer, or script) that runs for longer "
+     "than this many milliseconds (0 to disable)");
 
   po::options_description backend_desc("Backend options");
   backend_desc.add_options()
@@ -38,7 +44,25 @@ int ParseOptions(int argc, char **argv) {
        "path to an input file to edit (any positional arguments will be "
        "assumed to also be input files, and that's the recommnded way to "
        "specify inputs)")
-      ("without-boost-asio", "don't use boost::asio for the main loop");
+      ("without-boost-asio", "don't use boost::asio for the main loop")
+      ("direct-output", "draw the screen with the built-in terminal output "
+       "code, rather than with ncurses")
+      ("frame-deadline", po::value<int>()->default_value(16),
+       "the longest time (in milliseconds) that screen updates are deferred "
+       "while there's more input to handle")
+      ("headless", "run without a terminal, drawing into an in-memory screen "
+       "(for tests and benchmarks); input is read from stdin")
+      ("screen-size", po::value<std::string>()->default_value("80x24"),
+       "the size of the screen with --headless, as COLUMNSxLINES")
+      ("dump-screen", po::value<std::string>(),
+       "with --headless, write the text on the screen to this file at exit")
+      ("record", po::value<std::string>(),
+       "record the keys typed to this file, so they can be replayed")
+      ("replay", po::value<std::string>(),
+       "replay keys recorded with --record instead of reading the terminal, "
+       "and report latency and throughput at exit")
+      ("replay-fast", "with --replay, replay keys as fast as they can be "
+       "handled, rather than at the speed they were typed");
 
   po::options_description all_desc("Allowed options");
   all_desc.add(help_desc).add(scripting_desc).add(backend_desc);
@@ -92,6 +116,17 @@ int ParseOptions(int argc, char **argv) {
         "--really-do-nothing\n");
     return 1;
   }
+  int cols, rows;
+  if (vm.count("headless") &&
+      (sscanf(vm["screen-size"].as<std::string>().c_str(), "%dx%d", &cols,
+              &rows) != 2 || cols <= 0 || rows <= 0)) {
+    printf("--screen-size should look like 80x24\n");
+    return 1;
+  }
+  if (vm.count("record") && vm.count("replay")) {
+    printf("--record and --replay can't be used together\n");
+    return 1;
+  }
   return NO_EXIT;
 }
 }
@@ -15,6 +15,7 @@
 #include "./embeddable.h"
 #include "./logging.h"
 #include "./module.h"
+#include "./watchdog.h"
 
 using v8::Arguments;
 using v8::Boolean;
@@ -156,6 +157,11 @@ Handle<Value> JSBuildInfo(const Arguments& args) {
 namespace e {
 void HandleError(const TryCatch &try_catch) {
   HandleScope scope;
+  if (!try_catch.CanContinue() && watchdog != nullptr &&
+      watchdog->Terminated()) {
+    // the script was stopped by the watchdog, which has already logged it
+    return;
+  }
   if (try_catch.HasCaught()) {
     Local<Value> exc = try_catch.Exception();
     Local<Message> message = try_catch.Message();
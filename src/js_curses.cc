@@ -5,12 +5,15 @@
 #include <v8.h>
 
 #include <string>
+#include <vector>
 
+#include "./curses_low_level.h"
 #include "./js.h"
 #include "./js_curses_window.h"
 #include "./keycode.h"
 #include "./logging.h"
 #include "./module.h"
+#include "./term_output.h"
 
 using v8::AccessorInfo;
 using v8::Arguments;
@@ -20,6 +23,7 @@ using v8::Handle;
 using v8::HandleScope;
 using v8::Integer;
 using v8::Local;
+using v8::Number;
 using v8::Object;
 using v8::String;
 using v8::Undefined;
@@ -156,12 +160,31 @@ void JSSetLength(Local<String> property, Local<Value> value,
 
 
 // @method: doupdate
-// @description: Calls the underlying ncurses `doupdate()` routine.
-CURSES_VOID_FUNC(Doupdate, doupdate)
+// @description: Calls the underlying ncurses `doupdate()` routine (or updates
+//               the screen with the built-in output code, when the editor is
+//               run with `--direct-output`).
+CURSES_VOID_FUNC(Doupdate, e::DoUpdate)
 
 // @method: refresh
 // @description: Calls the underlying ncurses `refresh()` routine.
-CURSES_VOID_FUNC(Refresh, refresh)
+Handle<Value> CursesRefresh(const Arguments& args) {
+  HandleScope scope;
+  int ret = e::NoutRefresh(stdscr);
+  if (ret == OK) {
+    ret = e::DoUpdate();
+  }
+  return scope.Close(Integer::New(ret));
+}
+
+// @method: bytesWritten
+// @description: Returns the number of bytes the direct output backend has
+//               written to the terminal so far (what curses draws itself isn't
+//               counted).
+Handle<Value> CursesBytesWritten(const Arguments& args) {
+  HandleScope scope;
+  return scope.Close(Number::New(
+      static_cast<double>(e::TerminalBytesWritten())));
+}
 
 // @method: color_pair
 // @param[pair]: #int the pair number
@@ -172,6 +195,26 @@ Handle<Value> CursesColorPair(const Arguments& args) {
   return scope.Close(Integer::New(COLOR_PAIR(pair)));
 }
 
+// @method: dumpScreen
+// @description: Returns the text on each row of the screen as an array of
+//               strings (with trailing spaces removed), for checking what's
+//               been drawn in tests. This only works when the screen is drawn
+//               with the built-in output code (i.e. with `--direct-output` or
+//               `--headless`); otherwise it returns `null`.
+Handle<Value> CursesDumpScreen(const Arguments& args) {
+  HandleScope scope;
+  if (e::direct_output == nullptr) {
+    return scope.Close(v8::Null());
+  }
+  std::vector<std::string> text = e::direct_output->ScreenText();
+  Local<v8::Array> rows = v8::Array::New(static_cast<int>(text.size()));
+  for (size_t i = 0; i < text.size(); i++) {
+    rows->Set(static_cast<uint32_t>(i),
+              String::New(text[i].data(), static_cast<int>(text[i].size())));
+  }
+  return scope.Close(rows);
+}
+
 // @method: init_pair
 // @param[pair]: #int the pair number
 // @param[foreground]: #int the foreground color
@@ -347,8 +390,10 @@ bool Build(Handle<Object> obj) {
   DECLARE_ACCESSOR(obj, A_ALTCHARSET);
   DECLARE_ACCESSOR(obj, A_CHARTEXT);
 
+  AddFunction(obj, "bytesWritten", &CursesBytesWritten);
   AddFunction(obj, "color_pair", &CursesColorPair);
   AddFunction(obj, "doupdate", &CursesDoupdate);
+  AddFunction(obj, "dumpScreen", &CursesDumpScreen);
   AddFunction(obj, "init_pair", &CursesInitPair);
   AddFunction(obj, "move", &CursesMove);
   AddFunction(obj, "newwin", &CursesNewwin);
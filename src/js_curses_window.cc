@@ -6,6 +6,7 @@
 
 #include <v8.h>
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -13,6 +14,8 @@
 #include "./embeddable.h"
 #include "./logging.h"
 #include "./js.h"
+#include "./status_bar.h"
+#include "./term_output.h"
 
 using v8::AccessorInfo;
 using v8::Arguments;
@@ -20,6 +23,7 @@ using v8::External;
 using v8::Handle;
 using v8::HandleScope;
 using v8::Integer;
+using v8::Local;
 using v8::Object;
 using v8::ObjectTemplate;
 using v8::String;
@@ -33,7 +37,19 @@ using v8::Value;
     return scope.Close(Integer::New(name(self->window_)));  \
   }
 
-#define CURSES_STRING_FUNC(name)                                        \
+// The string functions are given the narrow and wide names of the curses
+// function, and call the wide one when curses has wide character support.
+#ifdef USE_NCURSESW
+#define CURSES_STRING_FUNC(name, wide_name)                             \
+  Handle<Value> JS_##name(const Arguments& args) {                      \
+    CHECK_ARGS(1);                                                      \
+    GET_SELF(JSCursesWindow);                                           \
+    int len = ToWide(args[0]);                                          \
+    return scope.Close(Integer::New(wide_name(self->window_,            \
+                                              wide_buf.data(), len)));  \
+  }
+#else
+#define CURSES_STRING_FUNC(name, wide_name)                             \
   Handle<Value> JS_##name(const Arguments& args) {                      \
     CHECK_ARGS(1);                                                      \
     GET_SELF(JSCursesWindow);                                           \
@@ -41,6 +57,7 @@ using v8::Value;
     return scope.Close(Integer::New(name(self->window_,                 \
                                          *value, value.length())));     \
   }
+#endif
 
 #define CURSES_INT_FUNC(name)                                           \
   Handle<Value> JS_##name(const Arguments& args) {                      \
@@ -67,7 +84,19 @@ using v8::Value;
     return scope.Close(Integer::New(name(self->window_, y, x)));        \
   }
 
-#define CURSES_YX_STRING_FUNC(name)                                     \
+#ifdef USE_NCURSESW
+#define CURSES_YX_STRING_FUNC(name, wide_name)                          \
+  Handle<Value> JS_##name(const Arguments& args) {                      \
+    CHECK_ARGS(3);                                                      \
+    GET_SELF(JSCursesWindow);                                           \
+    int y = static_cast<int>(args[0]->Int32Value());                    \
+    int x = static_cast<int>(args[1]->Int32Value());                    \
+    int len = ToWide(args[2]);                                          \
+    return scope.Close(Integer::New(wide_name(                          \
+        self->window_, y, x, wide_buf.data(), len)));                   \
+  }
+#else
+#define CURSES_YX_STRING_FUNC(name, wide_name)                          \
   Handle<Value> JS_##name(const Arguments& args) {                      \
     CHECK_ARGS(3);                                                      \
     GET_SELF(JSCursesWindow);                                           \
@@ -77,6 +106,7 @@ using v8::Value;
     return scope.Close(Integer::New(name(                               \
         self->window_, y, x, *value, value.length())));                 \
   }
+#endif
 
 namespace e {
 JSCursesWindow::JSCursesWindow(WINDOW *win)
@@ -93,6 +123,49 @@ JSCursesWindow::~JSCursesWindow() {
 }
 
 namespace {
+// Scratch buffers for the text being drawn. They're reused from call to call,
+// so drawing doesn't allocate once they're big enough (windows are only drawn
+// from the main thread).
+std::vector<uint16_t> utf16_buf;
+#ifdef USE_NCURSESW
+std::vector<wchar_t> wide_buf;
+#endif
+
+// Copy the UTF-16 code units of a JS string into utf16_buf, returning the
+// number of code units
+int ToUtf16(Handle<Value> value) {
+  Local<String> str = value->ToString();
+  const int len = str->Length();
+  if (utf16_buf.size() < static_cast<size_t>(len) + 1) {
+    utf16_buf.resize(len + 1);
+  }
+  str->Write(utf16_buf.data(), 0, len);
+  return len;
+}
+
+#ifdef USE_NCURSESW
+// Convert a JS string to a null-terminated wide string in wide_buf, returning
+// the number of characters (a surrogate pair becomes one character)
+int ToWide(Handle<Value> value) {
+  const int len = ToUtf16(value);
+  if (wide_buf.size() < static_cast<size_t>(len) + 1) {
+    wide_buf.resize(len + 1);
+  }
+  const uint16_t *chars = utf16_buf.data();
+  int n = 0;
+  for (int i = 0; i < len; i++) {
+    uint32_t c = chars[i];
+    if (c >= 0xD800 && c < 0xDC00 && i + 1 < len &&
+        chars[i + 1] >= 0xDC00 && chars[i + 1] < 0xE000) {
+      c = 0x10000 + ((c - 0xD800) << 10) + (chars[++i] - 0xDC00);
+    }
+    wide_buf[n++] = static_cast<wchar_t>(c);
+  }
+  wide_buf[n] = 0;
+  return n;
+}
+#endif
+
 // @class: curses.Window
 // @description: The JS representation of a `curses.WINDOW` object. In general,
 //               the commands below correspond to the `w*` commands in curses,
@@ -105,7 +178,7 @@ namespace {
 // @method: addstr
 // @param[str]: #string the string to draw
 // @description: Adds a string at the current cursor location.
-CURSES_STRING_FUNC(waddnstr)
+CURSES_STRING_FUNC(waddnstr, waddnwstr)
 
 // @method: attron
 // @param[attrs]: #int The attributes to turn on.
@@ -134,6 +207,113 @@ CURSES_VOID_FUNC(wclrtobot)
 // @description: Clears from the cursor to the end of the line.
 CURSES_VOID_FUNC(wclrtoeol)
 
+// @method: createStatusBar
+// @description: Creates a `StatusBar` that draws into the window.
+Handle<Value> JSCreateStatusBar(const Arguments& args) {
+  GET_SELF(JSCursesWindow);
+  HandleScope scope;
+  StatusBar *bar = new StatusBar(self, args.Holder());
+  return scope.Close(bar->ToScript());
+}
+
+// @method: drawLine
+// @param[y]: #int the y-coordinate to draw at
+// @param[x]: #int the x-coordinate to draw at
+// @param[text]: #string the text to draw
+// @param[runs]: #object a `Uint32Array` (or an array of numbers) of
+//               `length, attributes` pairs
+// @description: Draws a line of text with a curses call per line rather than
+//               per attribute change. The first run's `length` characters are
+//               drawn with its attributes (which may include a color pair),
+//               the next run's characters with its attributes, and so on;
+//               characters past the last run are drawn with the window's
+//               attributes. Lengths count UTF-16 code units, like the
+//               `length` of a string. The text is cut off at the right edge of
+//               the window, and the cursor isn't moved.
+Handle<Value> JS_drawLine(const Arguments& args) {
+  CHECK_ARGS(4);
+  GET_SELF(JSCursesWindow);
+  int y = static_cast<int>(args[0]->Int32Value());
+  int x = static_cast<int>(args[1]->Int32Value());
+  const int len = ToUtf16(args[2]);
+  if (!args[3]->IsObject()) {
+    return scope.Close(v8::ThrowException(v8::Exception::TypeError(
+        String::New("drawLine() expects an array of runs"))));
+  }
+
+  // typed arrays are read in place, anything else is copied
+  static std::vector<uint32_t> run_copy;
+  Handle<Object> runs_obj = args[3]->ToObject();
+  const uint32_t *runs;
+  size_t num_runs;
+  if (runs_obj->HasIndexedPropertiesInExternalArrayData() &&
+      (runs_obj->GetIndexedPropertiesExternalArrayDataType() ==
+       v8::kExternalUnsignedIntArray)) {
+    runs = static_cast<const uint32_t *>(
+        runs_obj->GetIndexedPropertiesExternalArrayData());
+    num_runs = runs_obj->GetIndexedPropertiesExternalArrayDataLength() / 2;
+  } else {
+    num_runs = runs_obj->Get(String::NewSymbol("length"))->Uint32Value() / 2;
+    run_copy.resize(num_runs * 2);
+    for (size_t i = 0; i < run_copy.size(); i++) {
+      run_copy[i] = runs_obj->Get(static_cast<uint32_t>(i))->Uint32Value();
+    }
+    runs = run_copy.data();
+  }
+
+  attr_t win_attrs;
+  short win_pair;  // NOLINT
+  wattr_get(self->window_, &win_attrs, &win_pair, nullptr);
+  win_attrs |= COLOR_PAIR(win_pair);
+
+  const int width = std::max(getmaxx(self->window_) - x, 0);
+  const uint16_t *chars = utf16_buf.data();
+#ifdef USE_NCURSESW
+  static std::vector<cchar_t> cells;
+#else
+  static std::vector<chtype> cells;
+#endif
+  cells.clear();
+  size_t run = 0;
+  size_t run_left = num_runs > 0 ? runs[0] : 0;
+  for (int i = 0; i < len && static_cast<int>(cells.size()) < width; i++) {
+    while (run < num_runs && run_left == 0) {
+      run++;
+      run_left = run < num_runs ? runs[run * 2] : 0;
+    }
+    const attr_t attrs =
+        run < num_runs ? static_cast<attr_t>(runs[run * 2 + 1]) : win_attrs;
+    run_left -= run_left > 0;
+    uint32_t ch = chars[i];
+    if (ch >= 0xD800 && ch < 0xDC00 && i + 1 < len &&
+        chars[i + 1] >= 0xDC00 && chars[i + 1] < 0xE000) {
+      ch = 0x10000 + ((ch - 0xD800) << 10) + (chars[i + 1] - 0xDC00);
+      i++;
+      run_left -= run_left > 0;
+    }
+    if (ch < 0x20 || ch == 0x7F) {
+      ch = '?';
+    }
+#ifdef USE_NCURSESW
+    wchar_t wch[2] = {static_cast<wchar_t>(ch), 0};
+    cchar_t cell;
+    setcchar(&cell, wch, attrs & ~A_COLOR,
+             static_cast<short>(PAIR_NUMBER(attrs)), nullptr);  // NOLINT
+    cells.push_back(cell);
+#else
+    cells.push_back(static_cast<chtype>(ch < 0x100 ? ch : '?') | attrs);
+#endif
+  }
+#ifdef USE_NCURSESW
+  int ret = mvwadd_wchnstr(self->window_, y, x, cells.data(),
+                           static_cast<int>(cells.size()));
+#else
+  int ret = mvwaddchnstr(self->window_, y, x, cells.data(),
+                         static_cast<int>(cells.size()));
+#endif
+  return scope.Close(Integer::New(ret));
+}
+
 // @method: erase
 // @description: Like `clear()`, but also calls `clearok()`.
 CURSES_VOID_FUNC(werase)
@@ -188,7 +368,7 @@ CURSES_YX_FUNC(wmove)
 // @param[str]: #string the string to draw
 // @description: Moves the cursor to the specified (y, x) coordinate, and then
 //               draws a string (updating the cursor position).
-CURSES_YX_STRING_FUNC(mvwaddnstr)
+CURSES_YX_STRING_FUNC(mvwaddnstr, mvwaddnwstr)
 
 // @method: mvdelch
 // @param[y]: #int the y-coordinate to move to
@@ -206,22 +386,46 @@ CURSES_YX_FUNC(mvwin)
 
 // @method: noutrefresh
 // @description: Copy the contents of the window to the virtual screen.
-CURSES_VOID_FUNC(wnoutrefresh)
+Handle<Value> JS_wnoutrefresh(const Arguments& args) {
+  CHECK_ARGS(0);
+  GET_SELF(JSCursesWindow);
+  return scope.Close(Integer::New(NoutRefresh(self->window_)));
+}
 
 // @method: redrawwin
 // @description: Redraw the window.
-CURSES_VOID_FUNC(redrawwin)
+Handle<Value> JS_redrawwin(const Arguments& args) {
+  CHECK_ARGS(0);
+  GET_SELF(JSCursesWindow);
+  return scope.Close(Integer::New(
+      RedrawLines(self->window_, 0, getmaxy(self->window_))));
+}
 
 // @method: redrawln
 // @param[beg_line]: #int the first corrupted line
 // @param[num_lines]: #int the number of corrupted lines
 // @description: Redraws multiple lines.
-CURSES_YX_FUNC(wredrawln)
+Handle<Value> JS_wredrawln(const Arguments& args) {
+  CHECK_ARGS(2);
+  GET_SELF(JSCursesWindow);
+  int beg_line = static_cast<int>(args[0]->Int32Value());
+  int num_lines = static_cast<int>(args[1]->Int32Value());
+  return scope.Close(Integer::New(
+      RedrawLines(self->window_, beg_line, num_lines)));
+}
 
 // @method: refresh
 // @description: Rereshes the window (i.e. causes the windows contents to be
 //               drawn to the screen).
-CURSES_VOID_FUNC(wrefresh)
+Handle<Value> JS_wrefresh(const Arguments& args) {
+  CHECK_ARGS(0);
+  GET_SELF(JSCursesWindow);
+  int ret = NoutRefresh(self->window_);
+  if (ret == OK) {
+    ret = DoUpdate();
+  }
+  return scope.Close(Integer::New(ret));
+}
 
 // @method: scrl
 // @param[n]: #int the number of lines to scroll
@@ -287,11 +491,15 @@ Handle<Value> JSSubwin(const Arguments& args) {
 
 Persistent<ObjectTemplate> templ;
 
+// Windows' second internal field points here, which tells them apart from the
+// other wrapped objects
+char window_tag;
+
 // Create a raw template
 Handle<ObjectTemplate> MakeTemplate() {
   HandleScope scope;
   Handle<ObjectTemplate> result = ObjectTemplate::New();
-  result->SetInternalFieldCount(1);
+  result->SetInternalFieldCount(2);
   js::AddTemplateFunction(result, "addstr", JS_waddnstr);
   js::AddTemplateFunction(result, "attron", JS_wattron);
   js::AddTemplateFunction(result, "attroff", JS_wattroff);
@@ -300,6 +508,8 @@ Handle<ObjectTemplate> MakeTemplate() {
   js::AddTemplateFunction(result, "clear", JS_wclear);
   js::AddTemplateFunction(result, "clrtobot", JS_wclrtobot);
   js::AddTemplateFunction(result, "clrtoeol", JS_wclrtoeol);
+  js::AddTemplateFunction(result, "createStatusBar", JSCreateStatusBar);
+  js::AddTemplateFunction(result, "drawLine", JS_drawLine);
   js::AddTemplateFunction(result, "getattrs", JS_getattrs);
   js::AddTemplateFunction(result, "getbegx", JS_getbegx);
   js::AddTemplateFunction(result, "getbegy", JS_getbegy);
@@ -335,8 +545,21 @@ Handle<Value> JSCursesWindow::ToScript() {
     templ = Persistent<ObjectTemplate>::New(raw_template);
   }
   Handle<Object> cw = templ->NewInstance();
-  ASSERT(cw->InternalFieldCount() == 1);
+  ASSERT(cw->InternalFieldCount() == 2);
   cw->SetInternalField(0, External::New(this));
+  cw->SetInternalField(1, External::New(&window_tag));
   return scope.Close(cw);
 }
+
+JSCursesWindow* JSCursesWindow::FromScript(Handle<Value> val) {
+  if (!val->IsObject()) {
+    return nullptr;
+  }
+  Handle<Object> obj = Handle<Object>::Cast(val);
+  if (obj->InternalFieldCount() != 2 ||
+      UnwrapObj<void>(obj, 1) != &window_tag) {
+    return nullptr;
+  }
+  return UnwrapObj<JSCursesWindow>(obj);
+}
 }
@@ -21,6 +21,10 @@ class JSCursesWindow {
   explicit JSCursesWindow(WINDOW *win);
   ~JSCursesWindow();
   Handle<Value> ToScript();
+
+  // Get the window that a script object wraps, or nullptr if it isn't a
+  // window
+  static JSCursesWindow* FromScript(Handle<Value> val);
  public:
   WINDOW *window_;
 };
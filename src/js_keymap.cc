@@ -0,0 +1,264 @@
+// Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+
+#include "./js_keymap.h"
+
+#include <v8.h>
+
+#include <string>
+#include <vector>
+
+#include "./embeddable.h"
+#include "./js.h"
+#include "./keycode.h"
+#include "./keymap.h"
+#include "./latency.h"
+#include "./module.h"
+
+using v8::Array;
+using v8::Boolean;
+using v8::Function;
+using v8::HandleScope;
+using v8::Integer;
+using v8::String;
+using v8::Undefined;
+
+namespace {
+const int kDefaultTimeout = 1000;  // like vim's timeoutlen
+
+e::Keymap keymap(kDefaultTimeout);
+
+// the functions bound, indexed by binding - 1 (unbound slots are empty, and
+// are reused)
+std::vector<Persistent<Function> > callbacks;
+
+// the last key of the pending sequence, whose event a bound prefix's function
+// is called with when the sequence is resolved (KeyCodes are never deleted)
+e::KeyCode *pending_key = nullptr;
+
+// Get the keys for a sequence: each character of a string is a key, and an
+// array can mix strings and keypad key codes (e.g. from curses.keycodes).
+bool ToKeys(Handle<Value> val, std::vector<e::Keymap::Key> *keys) {
+  if (val->IsString()) {
+    String::Value chars(val);
+    for (int i = 0; i < chars.length(); i++) {
+      keys->push_back(e::Keymap::MakeKey((*chars)[i], false));
+    }
+    return true;
+  } else if (val->IsNumber()) {
+    keys->push_back(e::Keymap::MakeKey(val->Uint32Value(), true));
+    return true;
+  } else if (val->IsArray()) {
+    Handle<Array> arr = Handle<Array>::Cast(val);
+    for (uint32_t i = 0; i < arr->Length(); i++) {
+      Local<Value> elt = arr->Get(i);
+      if (elt->IsArray() || !ToKeys(elt, keys)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+// Run a binding with the key that finished it; returns false if it threw.
+bool Run(int binding, Handle<Value> event) {
+  Handle<Value> argv[] = {event};
+  Local<Value> result = callbacks[binding - 1]->Call(
+      Context::GetCurrent()->Global(), 1, argv);
+  return !result.IsEmpty();
+}
+
+// @class: keymap
+// @description: Key bindings for modes. Sequences of keys are bound to
+//               functions in a mode, and the keys for the current mode are
+//               matched by native code; only the bound function is called.
+//               Each character of a string is a key, and keypad keys are given
+//               by their codes (so an array like `['g', KEY_HOME]` is a
+//               sequence of two keys).
+
+// @method: bind
+// @param[mode]: #string the mode to bind the keys in
+// @param[keys]: #string the sequence of keys (a string, a keypad key code, or
+//               an array of them)
+// @param[callback]: #function called with the last key's event when the
+//                   sequence is typed in the mode
+// @description: Binds a sequence of keys, replacing what it was bound to.
+Handle<Value> JSBind(const Arguments& args) {
+  CHECK_ARGS(3);
+  std::vector<e::Keymap::Key> keys;
+  if (!ToKeys(args[1], &keys) || keys.empty() || !args[2]->IsFunction()) {
+    return scope.Close(Boolean::New(false));
+  }
+  int binding = 0;
+  for (size_t i = 0; i < callbacks.size(); i++) {
+    if (callbacks[i].IsEmpty()) {
+      binding = static_cast<int>(i) + 1;
+      break;
+    }
+  }
+  if (binding == 0) {
+    callbacks.push_back(Persistent<Function>());
+    binding = static_cast<int>(callbacks.size());
+  }
+  callbacks[binding - 1] = Persistent<Function>::New(
+      Handle<Function>::Cast(args[2]));
+
+  e::Keymap::ModeId mode = keymap.Intern(e::js::ValueToString(args[0]));
+  int old = keymap.Bind(mode, keys, binding);
+  if (old != 0) {
+    callbacks[old - 1].Dispose();
+    callbacks[old - 1].Clear();
+  }
+  return scope.Close(Boolean::New(true));
+}
+
+// @method: unbind
+// @param[mode]: #string the mode the keys are bound in
+// @param[keys]: #string the sequence of keys
+// @description: Unbinds a sequence of keys; returns true if it was bound.
+Handle<Value> JSUnbind(const Arguments& args) {
+  CHECK_ARGS(2);
+  std::vector<e::Keymap::Key> keys;
+  if (!ToKeys(args[1], &keys)) {
+    return scope.Close(Boolean::New(false));
+  }
+  e::Keymap::ModeId mode = keymap.Intern(e::js::ValueToString(args[0]));
+  int old = keymap.Unbind(mode, keys);
+  if (old == 0) {
+    return scope.Close(Boolean::New(false));
+  }
+  callbacks[old - 1].Dispose();
+  callbacks[old - 1].Clear();
+  return scope.Close(Boolean::New(true));
+}
+
+// @method: setMode
+// @param[mode]: #string the mode
+// @description: Sets the mode that keys are dispatched in; this discards any
+//               pending sequence.
+Handle<Value> JSSetMode(const Arguments& args) {
+  CHECK_ARGS(1);
+  keymap.SetMode(keymap.Intern(e::js::ValueToString(args[0])));
+  return Undefined();
+}
+
+// @method: setTimeout
+// @param[millis]: #int the timeout, in milliseconds (0 for none)
+// @description: Sets how long a pending sequence waits for its next key. A
+//               sequence that's timed out is resolved when the next key comes
+//               in, or by `flush()` (which the keypress code calls once the
+//               timeout has passed): if it's bound itself (e.g. `g` when `gg`
+//               is also bound), its function is called.
+Handle<Value> JSSetTimeout(const Arguments& args) {
+  CHECK_ARGS(1);
+  keymap.SetTimeout(args[0]->Int32Value());
+  return Undefined();
+}
+
+// @method: getTimeout
+// @description: Returns how long a pending sequence waits for its next key, in
+//               milliseconds (0 for no timeout).
+Handle<Value> JSGetTimeout(const Arguments& args) {
+  HandleScope scope;
+  return scope.Close(Integer::New(keymap.Timeout()));
+}
+
+// @method: startsSequence
+// @param[event]: #object a keypress event
+// @description: Returns true if a sequence bound in the current mode starts
+//               with the event's key.
+Handle<Value> JSStartsSequence(const Arguments& args) {
+  CHECK_ARGS(1);
+  e::KeyCode *key = e::KeyCode::FromScript(args[0]);
+  if (key == nullptr) {
+    return scope.Close(v8::ThrowException(v8::Exception::TypeError(
+        String::New("startsSequence() expects a keypress event"))));
+  }
+  return scope.Close(Boolean::New(keymap.StartsSequence(
+      e::Keymap::MakeKey(key->Code(), key->IsKeypad()))));
+}
+
+// @method: dispatch
+// @param[event]: #object the keypress event
+// @description: Matches a key in the current mode, calling the function bound
+//               to the sequence it finishes. Returns `keymap.BOUND` if a
+//               sequence was finished, `keymap.PENDING` if the key is part of
+//               a longer sequence, or `keymap.UNBOUND` if it isn't bound. If
+//               the key resolves a pending sequence that's bound itself, that
+//               sequence's function is called first, with the event for the
+//               sequence's own last key.
+Handle<Value> JSDispatch(const Arguments& args) {
+  CHECK_ARGS(1);
+  e::KeyCode *key = e::KeyCode::FromScript(args[0]);
+  if (key == nullptr) {
+    return scope.Close(v8::ThrowException(v8::Exception::TypeError(
+        String::New("dispatch() expects a keypress event"))));
+  }
+  int binding, flushed;
+  e::KeyCode *flushed_key = pending_key;
+  e::Keymap::Result result = keymap.Feed(
+      e::Keymap::MakeKey(key->Code(), key->IsKeypad()), e::MonotonicNanos(),
+      &binding, &flushed);
+  if (result == e::Keymap::PENDING) {
+    pending_key = key;
+  }
+  if (flushed != 0 && !Run(flushed, flushed_key->ToScript())) {
+    return Handle<Value>();
+  }
+  if (binding != 0 && !Run(binding, args[0])) {
+    return Handle<Value>();
+  }
+  return scope.Close(Integer::New(result));
+}
+
+// @method: flush
+// @description: Resolves the pending sequence now, calling its function (with
+//               the event for the sequence's last key) if it's bound itself.
+//               Returns true if a function was called.
+Handle<Value> JSFlush(const Arguments& args) {
+  HandleScope scope;
+  int binding = keymap.Flush();
+  if (binding == 0) {
+    return scope.Close(Boolean::New(false));
+  }
+  if (!Run(binding, pending_key->ToScript())) {
+    return Handle<Value>();
+  }
+  return scope.Close(Boolean::New(true));
+}
+
+// @method: pendingLength
+// @description: Returns the number of keys in the pending sequence.
+Handle<Value> JSPendingLength(const Arguments& args) {
+  HandleScope scope;
+  return scope.Close(Integer::New(
+      static_cast<int>(keymap.PendingLength())));
+}
+}
+
+namespace e {
+namespace js_keymap {
+bool Build(Handle<Object> obj) {
+  HandleScope scope;
+  AddFunction(obj, "bind", JSBind);
+  AddFunction(obj, "dispatch", JSDispatch);
+  AddFunction(obj, "flush", JSFlush);
+  AddFunction(obj, "getTimeout", JSGetTimeout);
+  AddFunction(obj, "pendingLength", JSPendingLength);
+  AddFunction(obj, "setMode", JSSetMode);
+  AddFunction(obj, "setTimeout", JSSetTimeout);
+  AddFunction(obj, "startsSequence", JSStartsSequence);
+  AddFunction(obj, "unbind", JSUnbind);
+
+  // @accessor: UNBOUND
+  AddInteger(obj, "UNBOUND", Keymap::UNBOUND);
+
+  // @accessor: PENDING
+  AddInteger(obj, "PENDING", Keymap::PENDING);
+
+  // @accessor: BOUND
+  AddInteger(obj, "BOUND", Keymap::BOUND);
+  return true;
+}
+}
+}
@@ -0,0 +1,15 @@
+// -*- C++ -*-
+// Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+
+#ifndef SRC_JS_KEYMAP_H_
+#define SRC_JS_KEYMAP_H_
+
+#include <v8.h>
+
+namespace e {
+namespace js_keymap {
+bool Build(v8::Handle<v8::Object>);
+}
+}
+
+#endif  // SRC_JS_KEYMAP_H_
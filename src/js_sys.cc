@@ -15,11 +15,13 @@
 
 #include "./assert.h"
 #include "./js.h"
+#include "./latency.h"
 #include "./module.h"
 
 using v8::Arguments;
 using v8::HandleScope;
 using v8::Integer;
+using v8::Number;
 using v8::ObjectTemplate;
 using v8::String;
 using v8::Undefined;
@@ -71,6 +73,42 @@ Handle<Value> JSKill(const Arguments& args) {
   int ret = kill(static_cast<pid_t>(pid), static_cast<int>(signal));
   return scope.Close(Integer::New(ret));
 }
+
+// @method: monotonicTime
+// @description: Returns the time from a monotonic clock, in microseconds
+//               (with a fractional part). This is only useful for measuring
+//               how long things take.
+Handle<Value> JSMonotonicTime(const Arguments& args) {
+  HandleScope scope;
+  return scope.Close(Number::New(e::MonotonicNanos() / 1e3));
+}
+
+// @method: latencyStats
+// @description: Returns how long keys have taken to get to the screen, as an
+//               object with a property for each stage: `read_to_keypress`,
+//               `keypress`, `after_keypress` and `read_to_update` (the whole
+//               trip). Each stage is an object with the properties `count`,
+//               `mean`, `p50`, `p90`, `p99` and `max`; times are in
+//               microseconds.
+Handle<Value> JSLatencyStats(const Arguments& args) {
+  HandleScope scope;
+  Local<Object> stats = Object::New();
+  for (int i = 0; i < e::LatencyTracker::NUM_STAGES; i++) {
+    const e::LatencyTracker::Stage stage =
+        static_cast<e::LatencyTracker::Stage>(i);
+    const e::Histogram &hist = e::latency.Get(stage);
+    Local<Object> obj = Object::New();
+    obj->Set(String::NewSymbol("count"),
+             Number::New(static_cast<double>(hist.Count())));
+    obj->Set(String::NewSymbol("mean"), Number::New(hist.Mean() / 1e3));
+    obj->Set(String::NewSymbol("p50"), Number::New(hist.Percentile(50) / 1e3));
+    obj->Set(String::NewSymbol("p90"), Number::New(hist.Percentile(90) / 1e3));
+    obj->Set(String::NewSymbol("p99"), Number::New(hist.Percentile(99) / 1e3));
+    obj->Set(String::NewSymbol("max"), Number::New(hist.Max() / 1e3));
+    stats->Set(String::NewSymbol(e::LatencyTracker::StageName(stage)), obj);
+  }
+  return scope.Close(stats);
+}
 }
 
 namespace e {
@@ -81,6 +119,8 @@ bool Build(Handle<Object> obj) {
   AddFunction(obj, "getcwd", JSGetcwd);
   AddFunction(obj, "getpid", JSGetpid);
   AddFunction(obj, "kill", JSKill);
+  AddFunction(obj, "latencyStats", JSLatencyStats);
+  AddFunction(obj, "monotonicTime", JSMonotonicTime);
   return true;
 }
 }
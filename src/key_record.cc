@@ -0,0 +1,227 @@
+// Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+
+#include "./key_record.h"
+
+#include <time.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "./latency.h"
+
+namespace {
+const char kMagic[] = "ekr1";
+const size_t kMagicLength = sizeof(kMagic) - 1;
+
+// The pth percentile of some (unsorted) samples, in microseconds
+double Percentile(std::vector<uint64_t> samples, int p) {
+  if (samples.empty()) {
+    return 0;
+  }
+  const size_t i = std::min(samples.size() - 1, samples.size() * p / 100);
+  std::nth_element(samples.begin(), samples.begin() + i, samples.end());
+  return samples[i] / 1e3;
+}
+
+std::string FormatLatencies(const char *name,
+                            const std::vector<uint64_t> &samples) {
+  char line[160];
+  snprintf(line, sizeof(line),
+           "%s: p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us", name,
+           Percentile(samples, 50), Percentile(samples, 90),
+           Percentile(samples, 99), Percentile(samples, 100));
+  return line;
+}
+}
+
+namespace e {
+KeyRecorder* KeyRecorder::Open(const std::string &path) {
+  FILE *file = fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    return nullptr;
+  }
+  fwrite(kMagic, 1, kMagicLength, file);
+  return new KeyRecorder(file);
+}
+
+KeyRecorder::KeyRecorder(FILE *file)
+    :file_(file), last_burst_(MonotonicNanos() / 1000) {
+}
+
+KeyRecorder::~KeyRecorder() {
+  EndBurst();
+  fclose(file_);
+}
+
+void KeyRecorder::Add(wint_t wch, bool is_keycode) {
+  keys_.push_back((static_cast<uint32_t>(wch) << 1) | is_keycode);
+}
+
+void KeyRecorder::EndBurst() {
+  if (keys_.empty()) {
+    return;
+  }
+  const uint64_t now = MonotonicNanos() / 1000;
+  WriteVarint(now - last_burst_);
+  WriteVarint(keys_.size());
+  for (uint32_t key : keys_) {
+    WriteVarint(key);
+  }
+  last_burst_ = now;
+  keys_.clear();
+}
+
+void KeyRecorder::WriteVarint(uint64_t val) {
+  while (val >= 0x80) {
+    putc(static_cast<int>((val & 0x7F) | 0x80), file_);
+    val >>= 7;
+  }
+  putc(static_cast<int>(val), file_);
+}
+
+KeyReplayer::KeyReplayer()
+    :pos_(kMagicLength), burst_left_(0), num_keys_(0), start_(0), due_(0) {
+}
+
+KeyReplayer* KeyReplayer::Open(const std::string &path) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return nullptr;
+  }
+  KeyReplayer *replayer = new KeyReplayer();
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+    replayer->data_.insert(replayer->data_.end(), buf, buf + n);
+  }
+  fclose(file);
+
+  // check the whole file, and count the keys
+  std::vector<uint8_t> &data = replayer->data_;
+  bool valid = (data.size() >= kMagicLength &&
+                memcmp(data.data(), kMagic, kMagicLength) == 0);
+  uint64_t delay, count, key;
+  while (valid && replayer->pos_ < data.size()) {
+    valid = replayer->ReadVarint(&delay) && replayer->ReadVarint(&count);
+    for (uint64_t i = 0; valid && i < count; i++) {
+      valid = replayer->ReadVarint(&key);
+    }
+    replayer->num_keys_ += count;
+  }
+  if (!valid) {
+    delete replayer;
+    return nullptr;
+  }
+  replayer->pos_ = kMagicLength;
+  return replayer;
+}
+
+bool KeyReplayer::ReadVarint(uint64_t *val) {
+  *val = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (pos_ >= data_.size()) {
+      return false;
+    }
+    const uint8_t byte = data_[pos_++];
+    *val |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool KeyReplayer::StartBurst(bool realtime) {
+  // skip whatever wasn't read of the last burst
+  uint64_t val;
+  for (; burst_left_ > 0; burst_left_--) {
+    ReadVarint(&val);
+  }
+  uint64_t delay, count;
+  if (pos_ >= data_.size() || !ReadVarint(&delay) || !ReadVarint(&count)) {
+    return false;
+  }
+  if (start_ == 0) {
+    start_ = MonotonicNanos() / 1000;
+  } else {
+    due_ += delay;
+  }
+  if (realtime) {
+    const uint64_t now = MonotonicNanos() / 1000;
+    if (start_ + due_ > now) {
+      const uint64_t wait = start_ + due_ - now;
+      timespec ts = {static_cast<time_t>(wait / 1000000),
+                     static_cast<long>((wait % 1000000) * 1000)};  // NOLINT
+      while (nanosleep(&ts, &ts) != 0) { }
+    }
+  }
+  burst_left_ = count;
+  return true;
+}
+
+bool KeyReplayer::Next(wint_t *wch, bool *is_keycode) {
+  uint64_t key;
+  if (burst_left_ > 0 && ReadVarint(&key)) {
+    burst_left_--;
+  } else {
+    return false;
+  }
+  *wch = static_cast<wint_t>(key >> 1);
+  *is_keycode = key & 1;
+  return true;
+}
+
+bool KeyReplayer::Pending() const {
+  return burst_left_ > 0;
+}
+
+ReplayStats::ReplayStats()
+    :start_(0), finish_(0), heap_start_(0), heap_finish_(0), bytes_start_(0),
+     bytes_finish_(0) {
+}
+
+void ReplayStats::Start(size_t heap_used, uint64_t bytes_written) {
+  start_ = MonotonicNanos();
+  heap_start_ = heap_used;
+  bytes_start_ = bytes_written;
+}
+
+void ReplayStats::Finish(size_t heap_used, uint64_t bytes_written) {
+  finish_ = MonotonicNanos();
+  heap_finish_ = heap_used;
+  bytes_finish_ = bytes_written;
+}
+
+void ReplayStats::AddKey(uint64_t nanos) {
+  keys_.push_back(nanos);
+}
+
+void ReplayStats::AddBurst(uint64_t nanos) {
+  bursts_.push_back(nanos);
+}
+
+std::vector<std::string> ReplayStats::Report() const {
+  std::vector<std::string> report;
+  char line[160];
+  const double seconds = (finish_ - start_) / 1e9;
+  snprintf(line, sizeof(line),
+           "replayed %zd keys in %zd bursts in %.3f s (%.1f keys/s)",
+           keys_.size(), bursts_.size(), seconds,
+           seconds > 0 ? keys_.size() / seconds : 0);
+  report.push_back(line);
+  report.push_back(FormatLatencies("key handling", keys_));
+  report.push_back(FormatLatencies("burst to screen update", bursts_));
+  snprintf(line, sizeof(line), "V8 heap: %zd KB -> %zd KB (%+ld KB)",
+           heap_start_ / 1024, heap_finish_ / 1024,
+           (static_cast<long>(heap_finish_) -  // NOLINT
+            static_cast<long>(heap_start_)) / 1024);  // NOLINT
+  report.push_back(line);
+  const uint64_t bytes = bytes_finish_ - bytes_start_;
+  const double per_key =
+      keys_.empty() ? 0 : static_cast<double>(bytes) / keys_.size();
+  snprintf(line, sizeof(line), "terminal output: %llu bytes (%.1f bytes/key)",
+           static_cast<unsigned long long>(bytes), per_key);  // NOLINT
+  report.push_back(line);
+  return report;
+}
+}
@@ -0,0 +1,112 @@
+// -*- C++ -*-
+// Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+//
+// Recording and replaying the keys read from the terminal, to reproduce (and
+// measure) editing sessions.
+//
+// A recording is a sequence of bursts. A burst is the keys read by one call to
+// CursesWindow::InnerOnRead(), which are all handled before the screen is
+// updated. Each burst is stored with the time since the previous one, so that
+// it can be replayed at the speed it was typed. The file starts with a magic
+// number, and everything after that is a varint: for each burst, the
+// microseconds since the last burst and the number of keys, followed by each
+// key (the character or key code, shifted left one bit, with the low bit set
+// for key codes). Typing takes about three bytes per key.
+
+#ifndef SRC_KEY_RECORD_H_
+#define SRC_KEY_RECORD_H_
+
+#include <stdint.h>
+#include <wchar.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace e {
+class KeyRecorder {
+ public:
+  // Start a recording, or return null if the file can't be created
+  static KeyRecorder* Open(const std::string &path);
+
+  // Write the last burst, and close the file
+  ~KeyRecorder();
+
+  // Add a key to the current burst
+  void Add(wint_t wch, bool is_keycode);
+
+  // Write the current burst to the file, if it has any keys
+  void EndBurst();
+
+ private:
+  FILE *file_;
+  uint64_t last_burst_;  // in microseconds
+  std::vector<uint32_t> keys_;
+
+  explicit KeyRecorder(FILE *file);
+  void WriteVarint(uint64_t val);
+};
+
+class KeyReplayer {
+ public:
+  // Load a recording, or return null if the file can't be read or isn't a
+  // recording
+  static KeyReplayer* Open(const std::string &path);
+
+  // Start the next burst. If realtime is true, first sleep until it's due
+  // (relative to when the first burst was started). Returns false once every
+  // burst has been replayed.
+  bool StartBurst(bool realtime);
+
+  // Get the next key of the current burst; returns false at the end of it
+  bool Next(wint_t *wch, bool *is_keycode);
+
+  // Are there keys left in the current burst?
+  bool Pending() const;
+
+  // The number of keys in the recording
+  inline size_t NumKeys() const { return num_keys_; }
+
+ private:
+  std::vector<uint8_t> data_;
+  size_t pos_;
+  size_t burst_left_;  // keys left to read in the current burst
+  size_t num_keys_;
+  uint64_t start_;  // when the first burst was started
+  uint64_t due_;  // when the current burst is due, relative to start_
+
+  KeyReplayer();
+  bool ReadVarint(uint64_t *val);
+};
+
+// Measurements taken while replaying a recording
+class ReplayStats {
+ public:
+  ReplayStats();
+
+  // Called before the first key is replayed, and after the last, with the
+  // size of the V8 heap and the number of bytes written to the terminal
+  void Start(size_t heap_used, uint64_t bytes_written);
+  void Finish(size_t heap_used, uint64_t bytes_written);
+
+  // Record the time taken to handle a key, and the time from the start of a
+  // burst until the screen was updated (both in nanoseconds)
+  void AddKey(uint64_t nanos);
+  void AddBurst(uint64_t nanos);
+
+  // A human readable report of the measurements, one line per statistic
+  std::vector<std::string> Report() const;
+
+ private:
+  std::vector<uint64_t> keys_;
+  std::vector<uint64_t> bursts_;
+  uint64_t start_;
+  uint64_t finish_;
+  size_t heap_start_;
+  size_t heap_finish_;
+  uint64_t bytes_start_;
+  uint64_t bytes_finish_;
+};
+}
+
+#endif  // SRC_KEY_RECORD_H_
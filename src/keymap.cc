@@ -0,0 +1,140 @@
+// Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+
+#include "./keymap.h"
+
+#include "./assert.h"
+
+namespace e {
+Keymap::Node::~Node() {
+  for (auto &child : children) {
+    delete child.second;
+  }
+}
+
+Keymap::Keymap(int timeout_millis)
+    :mode_(0), pending_(nullptr), pending_length_(0), last_key_(0) {
+  SetTimeout(timeout_millis);
+  Intern("");  // so there's always a current mode
+}
+
+Keymap::~Keymap() {
+  for (Node *root : modes_) {
+    delete root;
+  }
+}
+
+Keymap::ModeId Keymap::Intern(const std::string &mode) {
+  auto it = mode_ids_.find(mode);
+  if (it != mode_ids_.end()) {
+    return it->second;
+  }
+  const ModeId id = static_cast<ModeId>(modes_.size());
+  mode_ids_[mode] = id;
+  modes_.push_back(new Node());
+  return id;
+}
+
+// Changing the bindings discards the pending sequence, since the node it's
+// pending on might not be there anymore (or might no longer be a prefix).
+int Keymap::Bind(ModeId mode, const std::vector<Key> &keys, int binding) {
+  ASSERT(mode < modes_.size());
+  ASSERT(!keys.empty());
+  ASSERT(binding > 0);
+  Reset();
+  Node *node = modes_[mode];
+  for (Key key : keys) {
+    Node *&child = node->children[key];
+    if (child == nullptr) {
+      child = new Node();
+    }
+    node = child;
+  }
+  const int old = node->binding;
+  node->binding = binding;
+  return old;
+}
+
+int Keymap::Unbind(ModeId mode, const std::vector<Key> &keys) {
+  ASSERT(mode < modes_.size());
+  Reset();
+  std::vector<Node*> path(1, modes_[mode]);
+  for (Key key : keys) {
+    auto it = path.back()->children.find(key);
+    if (it == path.back()->children.end()) {
+      return 0;
+    }
+    path.push_back(it->second);
+  }
+  if (path.size() == 1) {
+    return 0;
+  }
+  const int old = path.back()->binding;
+  path.back()->binding = 0;
+
+  // remove the nodes that no longer lead to a binding
+  for (size_t i = keys.size(); i > 0; i--) {
+    Node *node = path[i];
+    if (node->binding != 0 || !node->children.empty()) {
+      break;
+    }
+    path[i - 1]->children.erase(keys[i - 1]);
+    delete node;
+  }
+  return old;
+}
+
+void Keymap::SetMode(ModeId mode) {
+  ASSERT(mode < modes_.size());
+  mode_ = mode;
+  Reset();
+}
+
+Keymap::Result Keymap::Feed(Key key, uint64_t now, int *binding,
+                            int *flushed) {
+  *binding = 0;
+  *flushed = 0;
+  if (pending_ != nullptr && timeout_ != 0 && now - last_key_ > timeout_) {
+    *flushed = Flush();
+  }
+  last_key_ = now;
+
+  Node *node = pending_ == nullptr ? modes_[mode_] : pending_;
+  auto it = node->children.find(key);
+  if (it == node->children.end() && pending_ != nullptr) {
+    // the key breaks the pending sequence; if that sequence is bound, it's
+    // run, and the key starts over from the top of the mode
+    const int pending_binding = Flush();
+    if (pending_binding == 0) {
+      return UNBOUND;
+    }
+    *flushed = pending_binding;
+    node = modes_[mode_];
+    it = node->children.find(key);
+  }
+  if (it == node->children.end()) {
+    return UNBOUND;
+  }
+
+  node = it->second;
+  if (!node->children.empty()) {
+    pending_ = node;
+    pending_length_++;
+    return PENDING;
+  }
+  ASSERT(node->binding != 0);  // leaves are always bound
+  Reset();
+  *binding = node->binding;
+  return BOUND;
+}
+
+int Keymap::Flush() {
+  const int binding = pending_ == nullptr ? 0 : pending_->binding;
+  Reset();
+  return binding;
+}
+
+void Keymap::Reset() {
+  pending_ = nullptr;
+  pending_length_ = 0;
+}
+}
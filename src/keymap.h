@@ -0,0 +1,113 @@
+// -*- C++ -*-
+// Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+//
+// Key bindings for modes. Each mode has a trie of key sequences, so binding a
+// sequence of several keys (like "dd" or "gg") is the same as binding a single
+// key. Keys are fed in one at a time: a key that's the prefix of a bound
+// sequence is pending until the next key, so matching a key is one lookup in
+// the trie no matter how many bindings there are.
+//
+// A binding is just a number here; the keymap module (js_keymap.cc) maps these
+// to the JavaScript functions that were bound.
+
+#ifndef SRC_KEYMAP_H_
+#define SRC_KEYMAP_H_
+
+#include <stdint.h>
+#include <wchar.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace e {
+class Keymap {
+ public:
+  // What a key fed in did
+  enum Result {
+    UNBOUND = 0,  // the key (or the sequence it was pending on) isn't bound
+    PENDING,  // the key is a prefix of a bound sequence
+    BOUND  // the key finished a bound sequence
+  };
+
+  // A key; keypad keys and characters are different keys even if their codes
+  // are the same
+  typedef uint32_t Key;
+  typedef uint32_t ModeId;
+
+  static inline Key MakeKey(wint_t code, bool is_keypad) {
+    return static_cast<Key>(code) | (is_keypad ? kKeypadBit : 0);
+  }
+
+  // A keymap whose pending sequences time out after timeout_millis (0 means
+  // they never do)
+  explicit Keymap(int timeout_millis);
+  ~Keymap();
+
+  // Get the id for a mode's name (creating the mode if it doesn't exist)
+  ModeId Intern(const std::string &mode);
+
+  // Bind a sequence of keys (which must not be empty) in a mode; returns what
+  // the sequence was bound to before, or 0 if it wasn't bound. Bindings must
+  // be positive.
+  int Bind(ModeId mode, const std::vector<Key> &keys, int binding);
+
+  // Unbind a sequence of keys; returns what the sequence was bound to, or 0
+  int Unbind(ModeId mode, const std::vector<Key> &keys);
+
+  // Switch to a mode; this discards any pending sequence
+  void SetMode(ModeId mode);
+  inline ModeId Mode() const { return mode_; }
+
+  // Feed a key in at a time (in nanoseconds, from MonotonicNanos()). If this
+  // is BOUND, binding is set to the binding to run.
+  //
+  // A pending sequence that the key doesn't continue (or that has timed out)
+  // is resolved first: if the sequence is bound itself (e.g. "g" when "gg" is
+  // also bound), flushed is set to its binding, which should be run before
+  // the binding for the key; otherwise flushed is 0. If a sequence that isn't
+  // bound itself is broken by a key, the key is UNBOUND.
+  Result Feed(Key key, uint64_t now, int *binding, int *flushed);
+
+  // Resolve the pending sequence now (e.g. when it's timed out and there are
+  // no more keys coming); returns its binding, or 0 if there's none
+  int Flush();
+
+  // The number of keys in the pending sequence
+  inline size_t PendingLength() const { return pending_length_; }
+
+  // Does a sequence bound in the current mode start with a key?
+  inline bool StartsSequence(Key key) const {
+    return modes_[mode_]->children.count(key) != 0;
+  }
+
+  // The timeout is only checked when a key is fed in; whoever feeds keys in
+  // should call Flush() once it's passed if no key has come.
+  inline void SetTimeout(int timeout_millis) {
+    timeout_ = static_cast<uint64_t>(timeout_millis) * 1000000;
+  }
+  inline int Timeout() const { return static_cast<int>(timeout_ / 1000000); }
+
+ private:
+  static const Key kKeypadBit = 1u << 31;
+
+  struct Node {
+    Node() :binding(0) {}
+    ~Node();
+    int binding;  // 0 if the sequence ending here isn't bound
+    std::map<Key, Node*> children;
+  };
+
+  std::map<std::string, ModeId> mode_ids_;
+  std::vector<Node*> modes_;  // the root of each mode's trie, by id
+  ModeId mode_;
+  Node *pending_;  // null unless a sequence is pending
+  size_t pending_length_;
+  uint64_t last_key_;  // when the last key was fed in
+  uint64_t timeout_;  // in nanoseconds
+
+  void Reset();
+};
+}
+
+#endif  // SRC_KEYMAP_H_
@@ -0,0 +1,155 @@
+// Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+
+#include "./latency.h"
+
+#include <time.h>
+
+#include <cstdio>
+
+#include "./assert.h"
+
+namespace e {
+LatencyTracker latency;
+
+uint64_t MonotonicNanos() {
+  timespec ts;
+  ASSERT(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+Histogram::Histogram() {
+  Reset();
+}
+
+// Values less than kSubBuckets get a bucket each. Above that, a value with
+// its highest bit at position b (b >= 4) is in the b - 3rd group of
+// kSubBuckets buckets, and which bucket in the group is given by the four
+// bits below the highest one.
+int Histogram::BucketFor(uint64_t val) {
+  if (val < kSubBuckets) {
+    return static_cast<int>(val);
+  }
+  const int high_bit = 63 - __builtin_clzll(val);
+  const int sub = static_cast<int>(val >> (high_bit - 4)) - kSubBuckets;
+  return (high_bit - 3) * kSubBuckets + sub;
+}
+
+uint64_t Histogram::BucketMax(int bucket) {
+  if (bucket < kSubBuckets) {
+    return static_cast<uint64_t>(bucket);
+  }
+  const int shift = bucket / kSubBuckets - 1;
+  const uint64_t sub = bucket % kSubBuckets;
+  return ((kSubBuckets + sub + 1) << shift) - 1;
+}
+
+void Histogram::Record(uint64_t val) {
+  counts_[BucketFor(val)].fetch_add(1, std::memory_order_relaxed);
+  total_.fetch_add(val, std::memory_order_relaxed);
+  uint64_t max = max_.load(std::memory_order_relaxed);
+  while (val > max &&
+         !max_.compare_exchange_weak(max, val, std::memory_order_relaxed)) { }
+  count_.fetch_add(1, std::memory_order_release);
+}
+
+uint64_t Histogram::Mean() const {
+  const uint64_t count = Count();
+  return count ? total_.load() / count : 0;
+}
+
+uint64_t Histogram::Percentile(double p) const {
+  const uint64_t count = Count();
+  if (count == 0) {
+    return 0;
+  }
+  uint64_t rank = static_cast<uint64_t>(p / 100 * count + 0.5);
+  if (rank < 1) {
+    rank = 1;
+  }
+  uint64_t seen = 0;
+  for (int i = 0; i < kBuckets; i++) {
+    seen += counts_[i].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      const uint64_t max = Max();
+      return BucketMax(i) < max ? BucketMax(i) : max;
+    }
+  }
+  return Max();
+}
+
+void Histogram::Reset() {
+  for (std::atomic<uint64_t> &count : counts_) {
+    count.store(0);
+  }
+  count_.store(0);
+  total_.store(0);
+  max_.store(0);
+}
+
+LatencyTracker::LatencyTracker()
+    :read_(0), keypress_(0), after_keypress_(0) {
+}
+
+void LatencyTracker::InputRead() {
+  if (read_ == 0) {
+    read_ = MonotonicNanos();
+  }
+}
+
+void LatencyTracker::KeypressStart() {
+  keypress_ = MonotonicNanos();
+  if (read_ != 0) {
+    stages_[READ_TO_KEYPRESS].Record(keypress_ - read_);
+  }
+}
+
+void LatencyTracker::KeypressEnd() {
+  stages_[KEYPRESS].Record(MonotonicNanos() - keypress_);
+}
+
+void LatencyTracker::AfterKeypressStart() {
+  after_keypress_ = MonotonicNanos();
+}
+
+void LatencyTracker::AfterKeypressEnd() {
+  stages_[AFTER_KEYPRESS].Record(MonotonicNanos() - after_keypress_);
+}
+
+void LatencyTracker::UpdateDone() {
+  if (read_ != 0) {
+    stages_[READ_TO_UPDATE].Record(MonotonicNanos() - read_);
+    read_ = 0;
+  }
+}
+
+const char* LatencyTracker::StageName(Stage stage) {
+  switch (stage) {
+    case READ_TO_KEYPRESS:
+      return "read_to_keypress";
+    case KEYPRESS:
+      return "keypress";
+    case AFTER_KEYPRESS:
+      return "after_keypress";
+    case READ_TO_UPDATE:
+      return "read_to_update";
+    default:
+      return "unknown";
+  }
+}
+
+std::vector<std::string> LatencyTracker::Summary() const {
+  std::vector<std::string> summary;
+  for (int i = 0; i < NUM_STAGES; i++) {
+    const Stage stage = static_cast<Stage>(i);
+    const Histogram &hist = Get(stage);
+    char line[160];
+    snprintf(line, sizeof(line), "latency %s: n=%llu p50=%.1fus p90=%.1fus "
+             "p99=%.1fus max=%.1fus", StageName(stage),
+             static_cast<unsigned long long>(hist.Count()),  // NOLINT
+             hist.Percentile(50) / 1e3, hist.Percentile(90) / 1e3,
+             hist.Percentile(99) / 1e3, hist.Max() / 1e3);
+    summary.push_back(line);
+  }
+  return summary;
+}
+}
@@ -0,0 +1,104 @@
+// -*- C++ -*-
+// Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+//
+// Measurements of how long it takes for a key to make it to the screen. The
+// time of each stage (from the input being read, through the keypress and
+// after_keypress events, to the screen update) is recorded into a histogram.
+//
+// The histograms are HDR-style: values are bucketed by their power of two,
+// and each power of two is split into 16 linear sub-buckets, so a value read
+// back is within about 6% of the value recorded, whatever its magnitude. The
+// counters are atomic, so recording never takes a lock and the histograms can
+// be read while they're being written.
+
+#ifndef SRC_LATENCY_H_
+#define SRC_LATENCY_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace e {
+class Histogram {
+ public:
+  Histogram();
+
+  // Record a value (in nanoseconds)
+  void Record(uint64_t val);
+
+  // The number of values recorded
+  inline uint64_t Count() const { return count_.load(); }
+
+  // The largest value recorded
+  inline uint64_t Max() const { return max_.load(); }
+
+  // The mean of the values recorded
+  uint64_t Mean() const;
+
+  // The value that p percent of the values recorded are no larger than (to
+  // within the precision of the histogram)
+  uint64_t Percentile(double p) const;
+
+  // Forget every value recorded
+  void Reset();
+
+ private:
+  static const int kSubBuckets = 16;
+  static const int kBuckets = 61 * kSubBuckets;
+
+  std::atomic<uint64_t> counts_[kBuckets];
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> total_;
+  std::atomic<uint64_t> max_;
+
+  static int BucketFor(uint64_t val);
+  static uint64_t BucketMax(int bucket);
+};
+
+class LatencyTracker {
+ public:
+  enum Stage {
+    READ_TO_KEYPRESS = 0,  // input read -> keypress dispatched
+    KEYPRESS,  // keypress dispatch started -> finished
+    AFTER_KEYPRESS,  // after_keypress dispatch started -> finished
+    READ_TO_UPDATE,  // input read -> doupdate() returned
+    NUM_STAGES
+  };
+
+  LatencyTracker();
+
+  // Input is ready to be read; this starts the clock for everything that
+  // happens until the next screen update (so it does nothing if the clock has
+  // already been started).
+  void InputRead();
+
+  void KeypressStart();
+  void KeypressEnd();
+  void AfterKeypressStart();
+  void AfterKeypressEnd();
+
+  // The screen has been updated; this stops the clock started by InputRead()
+  void UpdateDone();
+
+  inline const Histogram& Get(Stage stage) const { return stages_[stage]; }
+  static const char* StageName(Stage stage);
+
+  // A summary of each stage, one line per stage
+  std::vector<std::string> Summary() const;
+
+ private:
+  Histogram stages_[NUM_STAGES];
+  uint64_t read_;  // when input was read (zero if the clock isn't running)
+  uint64_t keypress_;
+  uint64_t after_keypress_;
+};
+
+extern LatencyTracker latency;
+
+// The current time from a monotonic clock, in nanoseconds
+uint64_t MonotonicNanos();
+}
+
+#endif  // SRC_LATENCY_H_
@@ -15,6 +15,8 @@
 #include "./embeddable.h"
 #include "./logging.h"
 #include "./js.h"
+#include "./utf8.h"
+#include "./wcwidth.h"
 
 using v8::AccessorInfo;
 using v8::Arguments;
@@ -34,13 +36,57 @@ using v8::Value;
 
 namespace e {
 
-void Line::Replace(const std::string& newline) {
-  std::vector<uint16_t> data;
-  for (auto it = newline.begin(); it != newline.end(); ++it) {
-    data.push_back(static_cast<uint16_t>(*it));
+namespace {
+// External array data for views of empty lines; V8 needs a valid pointer even
+// when there are no elements.
+uint16_t empty_data[1] = {0};
+
+// Create an object whose indexed properties are backed by external data.
+Persistent<Object> MakeView(const void *data, v8::ExternalArrayType type,
+                            size_t length, uint32_t version) {
+  HandleScope scope;
+  if (length == 0) {
+    data = empty_data;
+  }
+  Local<Object> view = Object::New();
+  view->SetIndexedPropertiesToExternalArrayData(
+      const_cast<void *>(data), type, static_cast<int>(length));
+  view->Set(String::NewSymbol("length"), Integer::New(length), v8::ReadOnly);
+  view->Set(String::NewSymbol("version"), Integer::NewFromUnsigned(version),
+            v8::ReadOnly);
+  return Persistent<Object>::New(view);
+}
+
+// Point a view at zero elements, and release our reference to it.
+void DetachView(Persistent<Object> *view) {
+  if (view->IsEmpty()) {
+    return;
+  }
+  HandleScope scope;
+  (*view)->SetIndexedPropertiesToExternalArrayData(
+      empty_data, (*view)->GetIndexedPropertiesExternalArrayDataType(), 0);
+  view->ClearWeak();
+  view->Dispose();
+  view->Clear();
+}
+}
+
+Line::~Line() {
+  DetachViews();
+}
+
+void Line::Replace(const char *data, size_t length) {
+  Touch();
+  std::vector<uint16_t> chars;
+  chars.reserve(length);
+  if (!Utf8ToUtf16(data, length, &chars)) {
+    chars.clear();
+    for (size_t i = 0; i < length; i++) {
+      chars.push_back(static_cast<uint8_t>(data[i]));
+    }
   }
   zipper_.Clear();
-  zipper_.Append(data.data(), newline.size());
+  zipper_.Append(chars.data(), chars.size());
 }
 
 Local<String> Line::ToV8String(bool refocus) const {
@@ -53,17 +99,131 @@ Local<String> Line::ToV8String(bool refocus) const {
 
 std::string Line::ToString(bool refocus) const {
   std::string str;
-  HandleScope scope;
-  Local<String> jstr = ToV8String(refocus);
-  if (jstr->Utf8Length()) {
-    std::unique_ptr<char[]> buf(new char[jstr->Utf8Length() + 1]);
-    jstr->WriteUtf8(buf.get(), jstr->Utf8Length());
-    buf.get()[jstr->Utf8Length()] = '\0';
-    str = buf.get();
+  if (refocus) {
+    AppendUtf8(&str);
+  } else {
+    std::unique_ptr<uint16_t[]> buf(new uint16_t[Size()]);
+    zipper_.ToBuffer(buf.get(), false);
+    Utf16ToUtf8(buf.get(), Size(), &str);
   }
   return str;
 }
 
+void Line::AppendUtf8(std::string *out) const {
+  Utf16ToUtf8(zipper_.Data(), Size(), out);
+}
+
+size_t Line::Utf8Size() const {
+  if (utf8_valid_) {
+    return utf8_.size();
+  }
+  return Utf8Length(zipper_.Data(), zipper_.Size());
+}
+
+size_t Line::ColumnOf(size_t index) const {
+  if (!columns_valid_) {
+    BuildColumns();
+  }
+  return columns_[std::min(index, Size())];
+}
+
+size_t Line::IndexAt(size_t column) const {
+  if (!columns_valid_) {
+    BuildColumns();
+  }
+  if (column >= columns_[Size()]) {
+    return Size();
+  }
+  // the character drawn at the column is the last one starting at or before
+  // it; a zero-width character (e.g. a combining mark) starts where the next
+  // character does, so it's never the last one
+  size_t index = std::upper_bound(columns_.begin(), columns_.end(), column) -
+      columns_.begin() - 1;
+
+  // the trailing half of a surrogate pair starts where the lead does, so step
+  // back to the start of the character
+  const uint16_t *chars = zipper_.Data();
+  if (index > 0 && chars[index] >= 0xDC00 && chars[index] < 0xE000 &&
+      chars[index - 1] >= 0xD800 && chars[index - 1] < 0xDC00) {
+    index--;
+  }
+  return index;
+}
+
+// Build the table of screen columns; columns_[i] is the column that the i-th
+// character starts at, and there's an extra entry at the end with the width of
+// the line.
+void Line::BuildColumns() const {
+  const size_t size = Size();
+  const uint16_t *chars = zipper_.Data();
+  columns_.resize(size + 1);
+  uint32_t column = 0;
+  for (size_t i = 0; i < size; i++) {
+    columns_[i] = column;
+    uint32_t c = chars[i];
+    if (c == '\t') {
+      column += TAB_SIZE - (column % TAB_SIZE);
+    } else if (c >= 0xD800 && c < 0xDC00 && i + 1 < size &&
+               chars[i + 1] >= 0xDC00 && chars[i + 1] < 0xE000) {
+      // the trailing half of a surrogate pair shares the column of the lead
+      c = 0x10000 + ((c - 0xD800) << 10) + (chars[i + 1] - 0xDC00);
+      columns_[++i] = column;
+      column += CharWidth(c);
+    } else {
+      column += CharWidth(c);
+    }
+  }
+  columns_[size] = column;
+  columns_valid_ = true;
+}
+
+const std::string& Line::Utf8() const {
+  if (!utf8_valid_) {
+    utf8_.clear();
+    AppendUtf8(&utf8_);
+    utf8_valid_ = true;
+  }
+  return utf8_;
+}
+
+Local<Object> Line::CharsView() {
+  HandleScope scope;
+  if (chars_view_.IsEmpty()) {
+    chars_view_ = MakeView(zipper_.Data(), v8::kExternalUnsignedShortArray,
+                           Size(), version_);
+    chars_view_.MakeWeak(this, &Line::OnCharsViewCollected);
+  }
+  return scope.Close(chars_view_);
+}
+
+Local<Object> Line::BytesView() {
+  HandleScope scope;
+  if (bytes_view_.IsEmpty()) {
+    const std::string &bytes = Utf8();
+    bytes_view_ = MakeView(bytes.data(), v8::kExternalUnsignedByteArray,
+                           bytes.size(), version_);
+    bytes_view_.MakeWeak(this, &Line::OnBytesViewCollected);
+  }
+  return scope.Close(bytes_view_);
+}
+
+void Line::DetachViews() {
+  DetachView(&chars_view_);
+  DetachView(&bytes_view_);
+}
+
+void Line::OnCharsViewCollected(Persistent<Value> val, void *param) {
+  Line *line = static_cast<Line *>(param);
+  val.Dispose();
+  line->chars_view_.Clear();
+}
+
+void Line::OnBytesViewCollected(Persistent<Value> val, void *param) {
+  Line *line = static_cast<Line *>(param);
+  val.Dispose();
+  line->bytes_view_.Clear();
+}
+
 namespace {
 // @class: Line
 // @description: This class is the internal representation of a line of text,
@@ -75,7 +235,7 @@ namespace {
 // @description: Appends the string to the line. Returns the new Line.
 Handle<Value> JSAppend(const Arguments& args) {
   CHECK_ARGS(1);
-  GET_SELF(Line);
+  GET_LIVE_SELF(Line);
 
   String::Value value(args[0]);
   self->Append(*value, static_cast<size_t>(value.length()));
@@ -87,7 +247,7 @@ Handle<Value> JSAppend(const Arguments& args) {
 // @description: Chops from the offset to the end of the line.
 Handle<Value> JSChop(const Arguments& args) {
   CHECK_ARGS(1);
-  GET_SELF(Line);
+  GET_LIVE_SELF(Line);
   uint32_t offset = args[0]->Uint32Value();
   self->Chop(static_cast<size_t>(offset));
   return scope.Close(Undefined());
@@ -100,7 +260,7 @@ Handle<Value> JSChop(const Arguments& args) {
 //               Line.
 Handle<Value> JSErase(const Arguments& args) {
   CHECK_ARGS(2);
-  GET_SELF(Line);
+  GET_LIVE_SELF(Line);
   Handle<Value> arg0 = args[0];
   Handle<Value> arg1 = args[1];
   size_t offset = static_cast<size_t>(arg0->Uint32Value());
@@ -115,17 +275,56 @@ Handle<Value> JSErase(const Arguments& args) {
 // @description: Inserts characters in the middle of the line.
 Handle<Value> JSInsert(const Arguments& args) {
   CHECK_ARGS(2);
-  GET_SELF(Line);
+  GET_LIVE_SELF(Line);
   Handle<Value> arg0 = args[0];
   Handle<Value> arg1 = args[1];
   size_t position = static_cast<size_t>(arg0->Uint32Value());
-  String::Utf8Value chars(arg1);
+  String::Value chars(arg1);
+  self->Insert(position, *chars, static_cast<size_t>(chars.length()));
+  return scope.Close(Undefined());
+}
 
-  for (int i = 0; i < chars.length(); i++) {
-    self->InsertChar(position++, (*chars)[i]);
-  }
+// @method: chars
+// @description: Returns a read-only, array-like view of the UTF-16 character
+//               codes in the line. The view has `length` and `version`
+//               properties; once the line is modified the view is emptied,
+//               and its `version` will no longer match the line's.
+Handle<Value> JSChars(const Arguments& args) {
+  HandleScope scope;
+  GET_LIVE_SELF(Line);
+  return scope.Close(self->CharsView());
+}
 
-  return scope.Close(Undefined());
+// @method: bytes
+// @description: Like `chars()`, but the view holds the UTF-8 encoded bytes of
+//               the line.
+Handle<Value> JSBytes(const Arguments& args) {
+  HandleScope scope;
+  GET_LIVE_SELF(Line);
+  return scope.Close(self->BytesView());
+}
+
+// @method: columnOf
+// @param[offset]: #int the offset of a character in the line
+// @description: Returns the screen column the character is drawn at, taking
+//               tabs and wide characters into account.
+Handle<Value> JSColumnOf(const Arguments& args) {
+  CHECK_ARGS(1);
+  GET_LIVE_SELF(Line);
+  size_t offset = static_cast<size_t>(args[0]->Uint32Value());
+  return scope.Close(Integer::New(self->ColumnOf(offset)));
+}
+
+// @method: indexAt
+// @param[column]: #int a screen column
+// @description: Returns the offset of the character drawn at a screen column
+//               (which may be in the middle of a tab or wide character), or
+//               the length of the line if the column is past its end.
+Handle<Value> JSIndexAt(const Arguments& args) {
+  CHECK_ARGS(1);
+  GET_LIVE_SELF(Line);
+  size_t column = static_cast<size_t>(args[0]->Uint32Value());
+  return scope.Close(Integer::New(self->IndexAt(column)));
 }
 
 // @method: value
@@ -133,7 +332,7 @@ Handle<Value> JSInsert(const Arguments& args) {
 // @description: Returns the contents of the line as a JavaScript string.
 Handle<Value> JSValue(const Arguments& args) {
   HandleScope scope;
-  GET_SELF(Line);
+  GET_LIVE_SELF(Line);
   bool refocus = true;
   if (args.Length() >= 1) {
     refocus = args[0]->ToBoolean()->Value();
@@ -145,18 +344,39 @@ Handle<Value> JSValue(const Arguments& args) {
 // @description: Returns the length of the line.
 Handle<Value> JSGetLength(Local<String> property, const AccessorInfo& info) {
   HandleScope scope;
-  ACCESSOR_GET_SELF(Line);
+  ACCESSOR_GET_LIVE_SELF(Line);
   return scope.Close(Integer::New(self->Size()));
 }
 
 void JSSetLength(Local<String> property, Local<Value> value,
                const AccessorInfo& info) {
   ACCESSOR_GET_SELF(Line);
+  if (self == nullptr) {
+    return;
+  }
   HandleScope scope;
   uint32_t newsize = value->Uint32Value();
   self->Chop(static_cast<size_t>(newsize));
 }
 
+// @accessor: displayWidth
+// @description: Returns the number of screen columns needed to display the
+//               line.
+Handle<Value> JSGetDisplayWidth(Local<String> property,
+                                const AccessorInfo& info) {
+  HandleScope scope;
+  ACCESSOR_GET_LIVE_SELF(Line);
+  return scope.Close(Integer::New(self->DisplayWidth()));
+}
+
+// @accessor: version
+// @description: A counter that changes every time the line is modified.
+Handle<Value> JSGetVersion(Local<String> property, const AccessorInfo& info) {
+  HandleScope scope;
+  ACCESSOR_GET_LIVE_SELF(Line);
+  return scope.Close(Integer::NewFromUnsigned(self->Version()));
+}
+
 Persistent<ObjectTemplate> line_template;
 
 // Create a raw template to assign to line_template
@@ -165,11 +385,17 @@ Handle<ObjectTemplate> MakeLineTemplate() {
   Handle<ObjectTemplate> result = ObjectTemplate::New();
   result->SetInternalFieldCount(1);
   js::AddTemplateFunction(result, "append", JSAppend);
+  js::AddTemplateFunction(result, "bytes", JSBytes);
+  js::AddTemplateFunction(result, "chars", JSChars);
   js::AddTemplateFunction(result, "chop", JSChop);
+  js::AddTemplateFunction(result, "columnOf", JSColumnOf);
   js::AddTemplateFunction(result, "erase", JSErase);
+  js::AddTemplateFunction(result, "indexAt", JSIndexAt);
   js::AddTemplateFunction(result, "insert", JSInsert);
   js::AddTemplateFunction(result, "value", JSValue);
+  js::AddTemplateAccessor(result, "displayWidth", JSGetDisplayWidth, nullptr);
   js::AddTemplateAccessor(result, "length", JSGetLength, JSSetLength);
+  js::AddTemplateAccessor(result, "version", JSGetVersion, nullptr);
   return handle_scope.Close(result);
 }
 }
@@ -180,9 +406,6 @@ Local<Value> Line::ToScript() {
     Handle<ObjectTemplate> raw_template = MakeLineTemplate();
     line_template = Persistent<ObjectTemplate>::New(raw_template);
   }
-  Local<Object> line = line_template->NewInstance();
-  ASSERT(line->InternalFieldCount() == 1);
-  line->SetInternalField(0, External::New(this));
-  return scope.Close(line);
+  return scope.Close(wrapper_.Wrap(line_template, this));
 }
 }
@@ -22,56 +22,173 @@
 #include <string>
 #include <vector>
 
+#include "./embeddable.h"
 #include "./zipper.h"
 
 using v8::Local;
+using v8::Object;
+using v8::Persistent;
 using v8::String;
 using v8::Value;
 
 namespace e {
 
+class Line;
+struct LineNode;
+
+// Interface for the owner of a line (i.e. the buffer it's in) to be told about
+// modifications to it.
+class LineObserver {
+ public:
+  virtual ~LineObserver() {}
+
+  // Called just before a line is modified
+  virtual void LineChanged(Line *line) = 0;
+};
+
 class Line {
  public:
-  Line() {}
-  explicit Line(const std::string &line) { Replace(line); }
+  Line() :version_(0), utf8_valid_(false), columns_valid_(false),
+          observer_(nullptr), node_(nullptr) {}
+  explicit Line(const std::string &line)
+      :version_(0), utf8_valid_(false), columns_valid_(false),
+       observer_(nullptr), node_(nullptr) {
+    Replace(line.data(), line.size());
+  }
+  Line(const char *data, size_t length)
+      :version_(0), utf8_valid_(false), columns_valid_(false),
+       observer_(nullptr), node_(nullptr) {
+    Replace(data, length);
+  }
+  ~Line();
   inline size_t Size() const { return zipper_.Size(); }
 
-  // Replace the contents of the line with the given ASCII string
-  void Replace(const std::string&);
+  // Replace the contents of the line with the given UTF-8 string. If the
+  // string isn't valid UTF-8 each byte is stored as its own character (i.e.
+  // it's treated as Latin-1).
+  void Replace(const char *data, size_t length);
+  inline void Replace(const std::string &s) { Replace(s.data(), s.size()); }
 
   // Insert a character at an arbitrary position
   inline void InsertChar(size_t position, uint16_t val) {
+    Touch();
     zipper_.Insert(position, val);
   }
 
   // Insert a character at an arbitrary position
   inline void InsertChar(size_t position, char val) {
+    Touch();
     zipper_.Insert(position, static_cast<uint16_t>(val));
   }
 
+  // Insert multiple characters at an arbitrary position
+  inline void Insert(size_t position, const uint16_t buf[], size_t length) {
+    Touch();
+    zipper_.Insert(position, buf, length);
+  }
+
   // Chop the string to be some new size
-  inline void Chop(size_t new_length) { zipper_.Chop(new_length); }
+  inline void Chop(size_t new_length) {
+    Touch();
+    zipper_.Chop(new_length);
+  }
 
   // Append to the string
   inline void Append(const uint16_t buf[], size_t length) {
+    Touch();
     zipper_.Append(buf, length);
   }
 
   // Erase count characters starting from position
   inline void Erase(size_t position, size_t count = 1) {
+    Touch();
     zipper_.Erase(position, count);
   }
 
+  // The version is bumped every time the line is modified; it's used by
+  // scripts to detect views that were created before the last edit.
+  inline uint32_t Version() const { return version_; }
+
+  // Get the characters of the line as one contiguous array; the pointer is only
+  // valid until the line is modified.
+  inline const uint16_t* Data() const { return zipper_.Data(); }
+
+  // The number of bytes in the UTF-8 encoding of the line
+  size_t Utf8Size() const;
+
+  // Set the object to notify of modifications, or nullptr
+  inline void SetObserver(LineObserver *observer) { observer_ = observer; }
+
+  // The line's node in its buffer's LineTree, which gives its position; the
+  // buffer should be the only caller of these methods
+  inline LineNode* Node() const { return node_; }
+  inline void SetNode(LineNode *node) { node_ = node; }
+
+  // Get the screen column that the character at index starts at, accounting
+  // for tabs and wide characters. An index equal to Size() gives the display
+  // width of the whole line.
+  size_t ColumnOf(size_t index) const;
+
+  // Get the index of the character displayed at some screen column (which may
+  // be in the middle of a tab or wide character). Returns Size() if the column
+  // is past the end of the line.
+  size_t IndexAt(size_t column) const;
+
+  // The number of screen columns needed to display the line.
+  inline size_t DisplayWidth() const { return ColumnOf(Size()); }
+
   // Write the contents to a V8 string.
   Local<String> ToV8String(bool refocus = true) const;
 
-  // Write the UTF-8 contents to a std::string (slow)
+  // Write the UTF-8 contents to a std::string
   std::string ToString(bool refocus = true) const;
 
+  // Append the UTF-8 contents to a std::string
+  void AppendUtf8(std::string *out) const;
+
+  // Get the UTF-8 contents of the line; the result is cached until the next
+  // modification.
+  const std::string& Utf8() const;
+
+  // Get read-only views of the line contents, as objects with external array
+  // data (UTF-16 characters and UTF-8 bytes respectively). Views are cached
+  // until the line is modified, at which point they're detached (i.e. they
+  // become empty).
+  Local<Object> CharsView();
+  Local<Object> BytesView();
+
   Local<Value> ToScript();
 
  private:
   Zipper<uint16_t> zipper_;
+  uint32_t version_;
+  mutable std::string utf8_;
+  mutable bool utf8_valid_;
+  mutable std::vector<uint32_t> columns_;  // screen column of each character
+  mutable bool columns_valid_;
+  LineObserver *observer_;
+  LineNode *node_;
+  Persistent<Object> chars_view_;
+  Persistent<Object> bytes_view_;
+  ScriptWrapper wrapper_;
+
+  // Called before each modification
+  inline void Touch() {
+    version_++;
+    utf8_valid_ = false;
+    columns_valid_ = false;
+    if (observer_ != nullptr) {
+      observer_->LineChanged(this);
+    }
+    if (!chars_view_.IsEmpty() || !bytes_view_.IsEmpty()) {
+      DetachViews();
+    }
+  }
+
+  void BuildColumns() const;
+  void DetachViews();
+  static void OnCharsViewCollected(Persistent<Value>, void *);
+  static void OnBytesViewCollected(Persistent<Value>, void *);
 };
 }
 
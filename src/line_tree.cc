@@ -0,0 +1,194 @@
+// Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+
+#include "./line_tree.h"
+
+#include "./assert.h"
+
+namespace e {
+void LineTree::Clear() {
+  Destroy(root_);
+  root_ = nullptr;
+}
+
+void LineTree::Insert(size_t position, const std::vector<size_t> &weights,
+                      std::vector<LineNode *> *nodes) {
+  ASSERT(position <= Size());
+  if (weights.empty()) {
+    return;
+  }
+
+  // Build a treap of the new nodes in one pass: the spine is the right
+  // spine of what's been built so far, and each node goes on the spine below
+  // the last node with a higher priority, taking what was below it there as
+  // its left subtree.
+  std::vector<LineNode *> spine;
+  for (size_t weight : weights) {
+    LineNode *node = new LineNode();
+    node->priority = NextPriority();
+    node->weight = weight;
+    LineNode *last = nullptr;
+    while (!spine.empty() && spine.back()->priority < node->priority) {
+      last = spine.back();
+      spine.pop_back();
+    }
+    node->left = last;
+    if (last != nullptr) {
+      last->parent = node;
+    }
+    if (!spine.empty()) {
+      spine.back()->right = node;
+      node->parent = spine.back();
+    }
+    spine.push_back(node);
+    nodes->push_back(node);
+  }
+
+  // the counts and sums can only be filled in once the shape is known
+  LineNode *built = spine.front();
+  Recount(built);
+
+  LineNode *left, *right;
+  Split(root_, position, &left, &right);
+  root_ = Merge(Merge(left, built), right);
+  root_->parent = nullptr;
+}
+
+void LineTree::Erase(size_t position, size_t count) {
+  ASSERT(position + count <= Size());
+  LineNode *left, *middle, *right;
+  Split(root_, position, &left, &right);
+  Split(right, count, &middle, &right);
+  Destroy(middle);
+  root_ = Merge(left, right);
+  if (root_ != nullptr) {
+    root_->parent = nullptr;
+  }
+}
+
+void LineTree::SetWeight(LineNode *node, size_t weight) {
+  node->weight = weight;
+  for (; node != nullptr; node = node->parent) {
+    node->sum = Sum(node->left) + node->weight + Sum(node->right);
+  }
+}
+
+size_t LineTree::PositionOf(const LineNode *node) const {
+  size_t position = Count(node->left);
+  for (; node->parent != nullptr; node = node->parent) {
+    if (node == node->parent->right) {
+      position += Count(node->parent->left) + 1;
+    }
+  }
+  ASSERT(node == root_);
+  return position;
+}
+
+size_t LineTree::PrefixSum(size_t count) const {
+  ASSERT(count <= Size());
+  size_t sum = 0;
+  const LineNode *node = root_;
+  while (count > 0) {
+    const size_t left = Count(node->left);
+    if (count <= left) {
+      node = node->left;
+    } else {
+      sum += Sum(node->left) + node->weight;
+      count -= left + 1;
+      node = node->right;
+    }
+  }
+  return sum;
+}
+
+size_t LineTree::Search(size_t sum) const {
+  size_t position = 0;
+  const LineNode *node = root_;
+  while (node != nullptr) {
+    const size_t left = Sum(node->left);
+    if (sum < left) {
+      node = node->left;
+      continue;
+    }
+    sum -= left;
+    position += Count(node->left);
+    if (sum < node->weight) {
+      break;
+    }
+    sum -= node->weight;
+    position++;
+    node = node->right;
+  }
+  return position;
+}
+
+uint32_t LineTree::NextPriority() {
+  // xorshift; the priorities only need to be well mixed, not unpredictable
+  seed_ ^= seed_ << 13;
+  seed_ ^= seed_ >> 17;
+  seed_ ^= seed_ << 5;
+  return seed_;
+}
+
+void LineTree::Recount(LineNode *node) {
+  if (node != nullptr) {
+    Recount(node->left);
+    Recount(node->right);
+    Update(node);
+  }
+}
+
+void LineTree::Update(LineNode *node) {
+  node->count = Count(node->left) + 1 + Count(node->right);
+  node->sum = Sum(node->left) + node->weight + Sum(node->right);
+}
+
+LineNode* LineTree::Merge(LineNode *left, LineNode *right) {
+  if (left == nullptr) {
+    return right;
+  } else if (right == nullptr) {
+    return left;
+  } else if (left->priority > right->priority) {
+    left->right = Merge(left->right, right);
+    left->right->parent = left;
+    Update(left);
+    return left;
+  } else {
+    right->left = Merge(left, right->left);
+    right->left->parent = right;
+    Update(right);
+    return right;
+  }
+}
+
+void LineTree::Split(LineNode *node, size_t count, LineNode **left,
+                     LineNode **right) {
+  if (node == nullptr) {
+    *left = nullptr;
+    *right = nullptr;
+    return;
+  }
+  const size_t left_count = Count(node->left);
+  if (left_count < count) {
+    Split(node->right, count - left_count - 1, &node->right, right);
+    if (node->right != nullptr) {
+      node->right->parent = node;
+    }
+    *left = node;
+  } else {
+    Split(node->left, count, left, &node->left);
+    if (node->left != nullptr) {
+      node->left->parent = node;
+    }
+    *right = node;
+  }
+  Update(node);
+}
+
+void LineTree::Destroy(LineNode *node) {
+  if (node != nullptr) {
+    Destroy(node->left);
+    Destroy(node->right);
+    delete node;
+  }
+}
+}
@@ -0,0 +1,95 @@
+// -*- C++ -*-
+// Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+//
+// A balanced tree (a treap) over the lines of a buffer, in order, where each
+// line has a weight (its length in bytes). Lines can be inserted and erased
+// anywhere, a weight can be changed, and a line's position or the sum of the
+// weights before a position can be found, all in O(log n) expected time; so
+// inserting or erasing a line never means rebuilding an index.
+
+#ifndef SRC_LINE_TREE_H_
+#define SRC_LINE_TREE_H_
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace e {
+
+// A node in the tree; lines keep a pointer to theirs to find their position
+struct LineNode {
+  LineNode *left;
+  LineNode *right;
+  LineNode *parent;
+  uint32_t priority;
+  size_t weight;
+  size_t count;  // the number of nodes in this subtree
+  size_t sum;  // the sum of the weights in this subtree
+};
+
+class LineTree {
+ public:
+  LineTree() :root_(nullptr), seed_(2463534242u) {}
+  ~LineTree() { Clear(); }
+
+  // The number of nodes in the tree
+  inline size_t Size() const { return Count(root_); }
+
+  void Clear();
+
+  // Insert nodes with the given weights before position, in O(k + log n) for
+  // k nodes; the new nodes are appended to nodes, in order
+  void Insert(size_t position, const std::vector<size_t> &weights,
+              std::vector<LineNode *> *nodes);
+
+  // Erase count nodes starting at position
+  void Erase(size_t position, size_t count);
+
+  // Change the weight of a node
+  void SetWeight(LineNode *node, size_t weight);
+
+  // The position of a node
+  size_t PositionOf(const LineNode *node) const;
+
+  // Sum of the weights of the first count nodes
+  size_t PrefixSum(size_t count) const;
+
+  // The position of the node that "contains" the offset sum, i.e. the largest
+  // count such that PrefixSum(count) <= sum (weights must be positive).
+  // Returns Size() if sum is at or past the total.
+  size_t Search(size_t sum) const;
+
+ private:
+  LineNode *root_;
+  uint32_t seed_;
+
+  LineTree(const LineTree &);
+  LineTree& operator=(const LineTree &);
+
+  uint32_t NextPriority();
+
+  static inline size_t Count(const LineNode *node) {
+    return node == nullptr ? 0 : node->count;
+  }
+  static inline size_t Sum(const LineNode *node) {
+    return node == nullptr ? 0 : node->sum;
+  }
+
+  // Recompute a node's count and sum from its children
+  static void Update(LineNode *node);
+
+  // Update each node of a subtree, from the bottom up
+  static void Recount(LineNode *node);
+
+  static LineNode* Merge(LineNode *left, LineNode *right);
+
+  // Split a subtree into its first count nodes and the rest
+  static void Split(LineNode *node, size_t count, LineNode **left,
+                    LineNode **right);
+
+  static void Destroy(LineNode *node);
+};
+}
+
+#endif  // SRC_LINE_TREE_H_
@@ -8,8 +8,10 @@
 #endif
 
 #include "./assert.h"
+#include "./curses_low_level.h"
 #include "./curses_window.h"
 #include "./flags.h"
+#include "./latency.h"
 #include "./logging.h"
 #include "./state.h"
 
@@ -32,14 +34,23 @@ int main(int argc, char **argv) {
   if (vm.count("script")) {
     scripts = vm["script"].as<std::vector<std::string> >();
   }
-  e::CursesWindow window(scripts, files);
-  window.Loop();
+  {
+    // the window (and the buffers it owns) may hold V8 handles, so it has to
+    // be destroyed before V8 is torn down
+    e::CursesWindow window(scripts, files);
+    window.Loop();
+  }
   v8::V8::Dispose();  // to assist heap checking
 #ifdef PLATFORM_LINUX
   rusage usage;
   ASSERT(getrusage(RUSAGE_SELF, &usage) == 0);
   e::LOG(e::INFO, "max rss size: %d MB", usage.ru_maxrss / 1024);
+  e::LOG(e::INFO, "terminal output: %llu bytes",
+         static_cast<unsigned long long>(e::TerminalBytesWritten()));  // NOLINT
 #endif  // PLATFORM_LINUX
+  for (const std::string &line : e::latency.Summary()) {
+    e::LOG(e::INFO, "%s", line.c_str());
+  }
   e::LOG(e::INFO, "main() finishing with status 0");
   return 0;
 }
@@ -6,6 +6,7 @@
 #include "./module.h"
 #include "./js_curses.h"
 #include "./js_errno.h"
+#include "./js_keymap.h"
 #include "./js_signal.h"
 #include "./js_sys.h"
 
@@ -18,6 +19,7 @@ void InitializeBuiltinModules() {
   is_initialized = true;
   DeclareBuiltinModule("curses", &e::js_curses::Build);
   DeclareBuiltinModule("errno", &e::js_errno::Build);
+  DeclareBuiltinModule("keymap", &e::js_keymap::Build);
   DeclareBuiltinModule("signal", &e::js_signal::Build);
   DeclareBuiltinModule("sys", &e::js_sys::Build);
 }
@@ -9,6 +9,7 @@
 #include <v8.h>
 
 #include <functional>
+#include <map>
 #include <string>
 
 #if OPTIMIZED_BUILD
@@ -18,9 +19,11 @@
 #include "./flags.h"
 #include "./io_service.h"
 #include "./js.h"
+#include "./latency.h"
 #include "./logging.h"
 #include "./module_decl.h"
 #include "./timer.h"
+#include "./watchdog.h"
 
 namespace e {
 
@@ -35,6 +38,7 @@ using v8::Function;
 using v8::FunctionTemplate;
 using v8::Integer;
 using v8::Local;
+using v8::Number;
 using v8::Object;
 using v8::ObjectTemplate;
 using v8::Persistent;
@@ -92,6 +96,65 @@ Handle<Value> JSAddEventListener(const Arguments& args) {
 
   return Undefined();
 }
+
+// @method: setEventBudget
+// @param[type]: #string the type of event (or "timer" for timers, or "script"
+//               for loading scripts)
+// @param[softMillis]: #int log the JavaScript stack once handling an event
+//                     has taken this long (0 to never)
+// @param[hardMillis]: #int stop handling an event once it has taken this long
+//                     (0 to never)
+// @description: Sets how long the handlers for an event type can run, in
+//               place of the `--script-soft-budget` and
+//               `--script-hard-budget` flags. This does nothing if both flags
+//               are 0.
+Handle<Value> JSSetEventBudget(const Arguments& args) {
+  CHECK_ARGS(3);
+  if (watchdog != nullptr) {
+    watchdog->SetBudget(js::ValueToString(args[0]->ToString()),
+                        args[1]->Int32Value(), args[2]->Int32Value());
+  }
+  return scope.Close(Undefined());
+}
+
+// @method: setListenerProfiling
+// @param[enabled]: #bool true to start profiling, false to stop
+// @description: Starts (or stops) recording the number of calls to, and the
+//               time spent in, each listener added with `addEventListener()`.
+//               Starting clears the previous profile.
+Handle<Value> JSSetListenerProfiling(const Arguments& args) {
+  CHECK_ARGS(1);
+  GET_SELF(State);
+  self->GetListener()->SetProfiling(args[0]->BooleanValue());
+  return scope.Close(Undefined());
+}
+
+// @method: listenerProfile
+// @description: Returns the profile recorded since `setListenerProfiling()`
+//               was called, as an array with an object for each listener
+//               called, with the properties `name` (its `displayName`, or its
+//               function name), `calls`, `total` and `max` (the times are in
+//               microseconds, and include the time spent in any listeners
+//               the listener dispatched to).
+Handle<Value> JSListenerProfile(const Arguments& args) {
+  GET_SELF(State);
+  HandleScope scope;
+  const std::map<std::string, EventListener::ListenerStats> &profile =
+      self->GetListener()->Profile();
+  Local<Array> result = Array::New(static_cast<int>(profile.size()));
+  uint32_t i = 0;
+  for (const auto &entry : profile) {
+    Local<Object> obj = Object::New();
+    obj->Set(String::NewSymbol("name"), String::New(entry.first.c_str()));
+    obj->Set(String::NewSymbol("calls"),
+             Number::New(static_cast<double>(entry.second.calls)));
+    obj->Set(String::NewSymbol("total"),
+             Number::New(entry.second.total / 1e3));
+    obj->Set(String::NewSymbol("max"), Number::New(entry.second.max / 1e3));
+    result->Set(i++, obj);
+  }
+  return scope.Close(result);
+}
 }
 
 State::State(const std::vector<std::string> &scripts,
@@ -102,6 +165,9 @@ State::State(const std::vector<std::string> &scripts,
 }
 
 State::~State() {
+  if (!pending_key_.IsEmpty()) {
+    pending_key_.Dispose();
+  }
   for (auto it = buffers_.begin(); it != buffers_.end(); ++it) {
     delete *it;
   }
@@ -116,6 +182,10 @@ void State::Run(std::function<void()> then) {
   Handle<ObjectTemplate> world_templ = ObjectTemplate::New();
   world_templ->SetInternalFieldCount(1);
   js::AddTemplateFunction(world_templ, "addEventListener", JSAddEventListener);
+  js::AddTemplateFunction(world_templ, "listenerProfile", JSListenerProfile);
+  js::AddTemplateFunction(world_templ, "setEventBudget", JSSetEventBudget);
+  js::AddTemplateFunction(world_templ, "setListenerProfiling",
+                          JSSetListenerProfiling);
   js::AddTemplateFunction(world_templ, "stopLoop", JSStopLoop);
 
   Persistent<Context> context = Context::New(nullptr, global);
@@ -139,6 +209,12 @@ void State::Run(std::function<void()> then) {
   // initialize all of the builtin modules (e.g. curses, errno, sys)
   InitializeBuiltinModules();
 
+  const int soft_budget = vm["script-soft-budget"].as<int>();
+  const int hard_budget = vm["script-hard-budget"].as<int>();
+  if (soft_budget > 0 || hard_budget > 0) {
+    watchdog = new Watchdog(soft_budget, hard_budget);
+  }
+
   bool bail = false;
 
   // Load the core script; this should be known to be good and not throw
@@ -151,7 +227,10 @@ void State::Run(std::function<void()> then) {
     TryCatch trycatch;
     Local<Script> script = GetCoreScript();
     HandleError(trycatch);
-    script->Run();
+    {
+      WatchdogScope watchdog_scope("script");
+      script->Run();
+    }
     HandleError(trycatch);
     LOG(INFO, "finished loading builtin core.js");
   }
@@ -188,7 +267,10 @@ void State::Run(std::function<void()> then) {
     Handle<Script> scr = Script::New(
         source, String::New(it->c_str(), it->size()));
     HandleError(trycatch);
-    scr->Run();
+    {
+      WatchdogScope watchdog_scope("script");
+      scr->Run();
+    }
     HandleError(trycatch);
     LOG(DBG, "finished loading additional script \"%s\"", it->c_str());
   }
@@ -198,6 +280,8 @@ void State::Run(std::function<void()> then) {
     then();
   }
   CancelAllTimers();
+  delete watchdog;
+  watchdog = nullptr;
   context.Dispose();
 }
 
@@ -215,16 +299,88 @@ void State::EnsureCoreScript() {
 }
 
 bool State::HandleKey(KeyCode *k) {
+  static const EventId keypress = EventListener::Intern("keypress");
   HandleScope scope;
 
-  std::vector<Handle<Value> > args;
-  args.push_back(k->ToScript());
+  Handle<Value> argv[] = {k->ToScript()};
   TryCatch trycatch;
-  listener_.Dispatch("keypress", args);
+  latency.KeypressStart();
+  listener_.Dispatch(keypress, Handle<Object>(), 1, argv);
+  latency.KeypressEnd();
   HandleError(trycatch);
-  listener_.Dispatch("after_keypress", args);
+
+  if (!pending_key_.IsEmpty()) {
+    pending_key_.Dispose();
+  }
+  pending_key_ = Persistent<Value>::New(argv[0]);
+  return keep_going;
+}
+
+bool State::WantsKeyBatches() {
+  static const EventId keypress_batch =
+      EventListener::Intern("keypress_batch");
+  return listener_.HasHandlers(keypress_batch);
+}
+
+bool State::HandleKeyBatch(const std::vector<KeyCode *> &keys) {
+  static const EventId keypress_batch =
+      EventListener::Intern("keypress_batch");
+  if (keys.empty()) {
+    return keep_going;
+  }
+  HandleScope scope;
+
+  const int count = static_cast<int>(keys.size());
+  Local<Array> batch = Array::New(count);
+  for (int i = 0; i < count; i++) {
+    batch->Set(static_cast<uint32_t>(i), keys[i]->ToScript());
+  }
+  Handle<Value> argv[] = {batch};
+  TryCatch trycatch;
+  latency.KeypressStart();
+  listener_.Dispatch(keypress_batch, Handle<Object>(), 1, argv);
+  latency.KeypressEnd();
   HandleError(trycatch);
 
+  if (!pending_key_.IsEmpty()) {
+    pending_key_.Dispose();
+  }
+  pending_key_ = Persistent<Value>::New(batch->Get(count - 1));
+  return keep_going;
+}
+
+bool State::HandlePaste(const uint16_t *text, size_t length) {
+  static const EventId paste = EventListener::Intern("paste");
+  HandleScope scope;
+
+  Handle<Value> argv[] = {String::New(text, static_cast<int>(length))};
+  TryCatch trycatch;
+  listener_.Dispatch(paste, Handle<Object>(), 1, argv);
+  HandleError(trycatch);
+
+  if (!pending_key_.IsEmpty()) {
+    pending_key_.Dispose();
+  }
+  pending_key_ = Persistent<Value>::New(argv[0]);
+  return keep_going;
+}
+
+bool State::Flush() {
+  if (pending_key_.IsEmpty()) {
+    return keep_going;
+  }
+  static const EventId after_keypress = EventListener::Intern("after_keypress");
+  HandleScope scope;
+
+  Handle<Value> argv[] = {Local<Value>::New(pending_key_)};
+  pending_key_.Dispose();
+  pending_key_.Clear();
+
+  TryCatch trycatch;
+  latency.AfterKeypressStart();
+  listener_.Dispatch(after_keypress, Handle<Object>(), 1, argv);
+  latency.AfterKeypressEnd();
+  HandleError(trycatch);
   return keep_going;
 }
 }
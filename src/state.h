@@ -37,9 +37,33 @@ class State {
 
   EventListener* GetListener(void) { return &listener_; }
 
-  // returns true if the mainloop should keep going, false otherwise
+  // Dispatch the keypress event for a key; returns true if the mainloop should
+  // keep going, false otherwise. The after_keypress event (which is what draws
+  // the screen) is deferred until the next call to Flush(), so that a burst of
+  // input only updates the screen once.
   bool HandleKey(KeyCode *k);
 
+  // Are there listeners for the keypress_batch event? If there are, keys
+  // should be handled with HandleKeyBatch() rather than HandleKey().
+  bool WantsKeyBatches();
+
+  // Dispatch the keypress_batch event, with an array of the keys read since
+  // the last batch (in the order they were read) as its argument. Like
+  // HandleKey(), this defers the after_keypress event, which gets the last
+  // key of the batch.
+  bool HandleKeyBatch(const std::vector<KeyCode *> &keys);
+
+  // Dispatch a paste event, with the pasted text (from a bracketed paste) as
+  // its argument. Like HandleKey(), this defers the after_keypress event.
+  bool HandlePaste(const uint16_t *text, size_t length);
+
+  // Dispatch the after_keypress event for the last key handled, if any keys
+  // have been handled since the last flush. Returns the same as HandleKey().
+  bool Flush();
+
+  // Have any keys been handled since the last flush?
+  inline bool FlushPending() const { return !pending_key_.IsEmpty(); }
+
  private:
   std::vector<std::string> scripts_;
   std::vector<std::string> args_;
@@ -47,6 +71,9 @@ class State {
   std::vector<Buffer*> buffers_;
   EventListener listener_;
 
+  // the last key (or pasted text) handled since the last flush
+  v8::Persistent<Value> pending_key_;
+
   // Ensure that the js/core.js script is in the list of loaded scripts; if it's
   // not, insert it at the front of the scripts_ list.
   void EnsureCoreScript();
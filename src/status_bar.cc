@@ -0,0 +1,356 @@
+// Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+
+#include "./status_bar.h"
+
+#include <v8.h>
+
+#ifdef USE_NCURSESW
+#ifdef PLATFORM_LINUX
+#ifndef _XOPEN_SOURCE_EXTENDED
+#define _XOPEN_SOURCE_EXTENDED
+#endif  // _X_OPEN_SOURCE_EXTENDED
+#include <ncursesw/curses.h>
+#else
+#include <curses.h>
+#endif  // PLATFORM_LINUX
+#else  // USE_NCURSESW
+#include <curses.h>  // NOLINT
+#endif  // USE_NCURSESW
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "./assert.h"
+#include "./embeddable.h"
+#include "./js.h"
+#include "./wcwidth.h"
+
+using v8::AccessorInfo;
+using v8::Arguments;
+using v8::External;
+using v8::Handle;
+using v8::HandleScope;
+using v8::Integer;
+using v8::Local;
+using v8::Object;
+using v8::ObjectTemplate;
+using v8::String;
+using v8::Undefined;
+using v8::Value;
+
+namespace {
+#ifdef USE_NCURSESW
+typedef cchar_t Cell;
+
+inline void AppendCell(std::vector<Cell> *cells, uint32_t c, int attrs) {
+  wchar_t wch[2] = {static_cast<wchar_t>(c), 0};
+  Cell cell;
+  setcchar(&cell, wch, attrs & ~A_COLOR,
+           static_cast<short>(PAIR_NUMBER(attrs)), nullptr);  // NOLINT
+  cells->push_back(cell);
+}
+
+inline int AddCells(WINDOW *win, int y, int x,
+                    const std::vector<Cell> &cells) {
+  return mvwadd_wchnstr(win, y, x, cells.data(),
+                        static_cast<int>(cells.size()));
+}
+#else
+typedef chtype Cell;
+
+// Without wide character support only ASCII can be drawn, so everything else
+// is drawn as question marks.
+inline void AppendCell(std::vector<Cell> *cells, uint32_t c, int attrs) {
+  if (c < 0x80) {
+    cells->push_back(static_cast<chtype>(c) | attrs);
+  } else {
+    cells->insert(cells->end(), e::CharWidth(c),
+                  static_cast<chtype>('?') | attrs);
+  }
+}
+
+inline int AddCells(WINDOW *win, int y, int x,
+                    const std::vector<Cell> &cells) {
+  return mvwaddchnstr(win, y, x, cells.data(),
+                      static_cast<int>(cells.size()));
+}
+#endif  // USE_NCURSESW
+}
+
+namespace e {
+StatusBar::StatusBar(JSCursesWindow *window, Handle<Object> window_object)
+    :window_(window), window_object_(Persistent<Object>::New(window_object)),
+     fields_painted_(0) {
+}
+
+StatusBar::~StatusBar() {
+  window_object_.Dispose();
+}
+
+StatusBar::Field *StatusBar::Find(const std::string &name) {
+  for (Field &field : fields_) {
+    if (field.name == name) {
+      return &field;
+    }
+  }
+  return nullptr;
+}
+
+void StatusBar::DefineField(const std::string &name, int row, int column,
+                            int width, int fill_attrs, bool align_right) {
+  Field *field = Find(name);
+  if (field == nullptr) {
+    fields_.push_back(Field());
+    field = &fields_.back();
+    field->name = name;
+    field->attrs = 0;
+  } else if (row != field->row || column != field->column ||
+             width < field->width) {
+    // the field no longer covers (all of) where it was drawn
+    BlankField(*field);
+  }
+  field->row = row;
+  field->column = column;
+  field->width = std::max(width, 0);
+  field->fill_attrs = fill_attrs;
+  field->align_right = align_right;
+  field->dirty = true;
+}
+
+bool StatusBar::SetField(const std::string &name, const uint16_t *text,
+                         size_t len, int attrs) {
+  Field *field = Find(name);
+  if (field == nullptr) {
+    return false;
+  }
+  if (attrs != field->attrs || len != field->text.size() ||
+      !std::equal(text, text + len, field->text.begin())) {
+    field->text.assign(text, text + len);
+    field->attrs = attrs;
+    field->dirty = true;
+  }
+  return true;
+}
+
+void StatusBar::Invalidate() {
+  for (Field &field : fields_) {
+    field.dirty = true;
+  }
+}
+
+int StatusBar::Repaint() {
+  WINDOW *win = window_->window_;
+  int cury, curx;
+  getyx(win, cury, curx);
+  fields_painted_ = 0;
+  for (Field &field : fields_) {
+    if (field.dirty) {
+      DrawField(field);
+      field.dirty = false;
+      fields_painted_++;
+    }
+  }
+  wmove(win, cury, curx);
+  return fields_painted_;
+}
+
+void StatusBar::DrawField(const Field &field) {
+  WINDOW *win = window_->window_;
+  const int maxy = getmaxy(win);
+  const int maxx = getmaxx(win);
+  if (field.row < 0 || field.row >= maxy || field.column < 0 ||
+      field.column >= maxx) {
+    return;
+  }
+  const int width = std::min(field.width, maxx - field.column);
+
+  // decode as much of the text as fits in the field
+  static std::vector<uint32_t> chars;
+  chars.clear();
+  int text_width = 0;
+  const std::vector<uint16_t> &text = field.text;
+  for (size_t i = 0; i < text.size(); i++) {
+    uint32_t c = text[i];
+    if (c >= 0xD800 && c < 0xDC00 && i + 1 < text.size() &&
+        text[i + 1] >= 0xDC00 && text[i + 1] < 0xE000) {
+      c = 0x10000 + ((c - 0xD800) << 10) + (text[++i] - 0xDC00);
+    }
+    if (c < 0x20 || c == 0x7F) {
+      c = '?';
+    }
+    const int w = CharWidth(c);
+    if (w <= 0) {
+      continue;
+    } else if (text_width + w > width) {
+      break;
+    }
+    chars.push_back(c);
+    text_width += w;
+  }
+
+  static std::vector<Cell> cells;
+  cells.clear();
+  const int padding = width - text_width;
+  if (field.align_right) {
+    for (int i = 0; i < padding; i++) {
+      AppendCell(&cells, ' ', field.fill_attrs);
+    }
+  }
+  for (uint32_t c : chars) {
+    AppendCell(&cells, c, field.attrs);
+  }
+  if (!field.align_right) {
+    for (int i = 0; i < padding; i++) {
+      AppendCell(&cells, ' ', field.fill_attrs);
+    }
+  }
+  AddCells(win, field.row, field.column, cells);
+}
+
+void StatusBar::BlankField(const Field &field) {
+  WINDOW *win = window_->window_;
+  const int maxy = getmaxy(win);
+  const int maxx = getmaxx(win);
+  if (field.row < 0 || field.row >= maxy || field.column < 0 ||
+      field.column >= maxx) {
+    return;
+  }
+  const int width = std::min(field.width, maxx - field.column);
+  static std::vector<Cell> cells;
+  cells.clear();
+  for (int i = 0; i < width; i++) {
+    AppendCell(&cells, ' ', field.fill_attrs);
+  }
+  int cury, curx;
+  getyx(win, cury, curx);
+  AddCells(win, field.row, field.column, cells);
+  wmove(win, cury, curx);
+
+  for (Field &other : fields_) {
+    if (&other != &field && other.row == field.row &&
+        other.column < field.column + width &&
+        field.column < other.column + other.width) {
+      other.dirty = true;
+    }
+  }
+}
+
+namespace {
+// @class: StatusBar
+// @description: Draws named fields into a window (see
+//               `curses.Window.createStatusBar()`).
+//
+// @method: defineField
+// @param[name]: #string the name of the field
+// @param[row]: #int the row of the window the field is on
+// @param[column]: #int the column the field starts at
+// @param[width]: #int the number of columns the field takes up
+// @param[fillAttrs]: #int the attributes of the spaces the text is padded
+//                    with (optional)
+// @param[alignRight]: #bool true to right-align the text (optional)
+// @description: Defines a field, or moves an existing one (blanking where it
+//               was drawn). The field is empty until its text is set.
+Handle<Value> JSDefineField(const Arguments& args) {
+  CHECK_ARGS(4);
+  GET_SELF(StatusBar);
+  String::Utf8Value name(args[0]);
+  int fill_attrs = args.Length() >= 5 ? args[4]->Int32Value() : 0;
+  bool align_right = args.Length() >= 6 ? args[5]->BooleanValue() : false;
+  self->DefineField(*name, args[1]->Int32Value(), args[2]->Int32Value(),
+                    args[3]->Int32Value(), fill_attrs, align_right);
+  return scope.Close(Undefined());
+}
+
+// @method: invalidate
+// @description: Marks every field as needing to be redrawn by the next
+//               `repaint()` (e.g. after the window has been cleared).
+Handle<Value> JSInvalidate(const Arguments& args) {
+  GET_SELF(StatusBar);
+  HandleScope scope;
+  self->Invalidate();
+  return scope.Close(Undefined());
+}
+
+// @method: repaint
+// @description: Draws the fields whose text or attributes have changed since
+//               they were last drawn, and returns the number of fields drawn.
+//               This should be called once per screen update, before
+//               `curses.doupdate()`.
+Handle<Value> JSRepaint(const Arguments& args) {
+  GET_SELF(StatusBar);
+  HandleScope scope;
+  return scope.Close(Integer::New(self->Repaint()));
+}
+
+// @method: set
+// @param[name]: #string the name of the field
+// @param[text]: #string the text of the field
+// @param[attrs]: #int the attributes to draw the text with (optional)
+// @description: Sets the text of a field. The field is only redrawn if the
+//               text or attributes are different from what's there now.
+Handle<Value> JSSet(const Arguments& args) {
+  CHECK_ARGS(2);
+  GET_SELF(StatusBar);
+  static std::vector<uint16_t> text;
+  String::Utf8Value name(args[0]);
+  Local<String> str = args[1]->ToString();
+  const size_t len = static_cast<size_t>(str->Length());
+  if (text.size() < len + 1) {
+    text.resize(len + 1);
+  }
+  str->Write(text.data(), 0, static_cast<int>(len));
+  int attrs = args.Length() >= 3 ? args[2]->Int32Value() : 0;
+  if (!self->SetField(*name, text.data(), len, attrs)) {
+    return scope.Close(v8::ThrowException(v8::Exception::RangeError(
+        String::New("no such status bar field"))));
+  }
+  return scope.Close(Undefined());
+}
+
+// @accessor: fieldsPainted
+// @description: The number of fields drawn by the last `repaint()`.
+Handle<Value> JSGetFieldsPainted(Local<String> property,
+                                 const AccessorInfo& info) {
+  HandleScope scope;
+  ACCESSOR_GET_SELF(StatusBar);
+  return scope.Close(Integer::New(self->FieldsPainted()));
+}
+
+Persistent<ObjectTemplate> status_bar_template;
+
+Handle<ObjectTemplate> MakeStatusBarTemplate() {
+  HandleScope scope;
+  Handle<ObjectTemplate> result = ObjectTemplate::New();
+  result->SetInternalFieldCount(1);
+  js::AddTemplateFunction(result, "defineField", JSDefineField);
+  js::AddTemplateAccessor(result, "fieldsPainted", JSGetFieldsPainted,
+                          nullptr);
+  js::AddTemplateFunction(result, "invalidate", JSInvalidate);
+  js::AddTemplateFunction(result, "repaint", JSRepaint);
+  js::AddTemplateFunction(result, "set", JSSet);
+  return scope.Close(result);
+}
+}
+
+Handle<Value> StatusBar::ToScript() {
+  HandleScope scope;
+  ASSERT(handle_.IsEmpty());
+  if (status_bar_template.IsEmpty()) {
+    Handle<ObjectTemplate> raw_template = MakeStatusBarTemplate();
+    status_bar_template = Persistent<ObjectTemplate>::New(raw_template);
+  }
+  Local<Object> obj = status_bar_template->NewInstance();
+  obj->SetInternalField(0, External::New(this));
+  handle_ = Persistent<Object>::New(obj);
+  handle_.MakeWeak(this, &StatusBar::OnCollected);
+  return scope.Close(obj);
+}
+
+void StatusBar::OnCollected(Persistent<Value> val, void *param) {
+  StatusBar *self = static_cast<StatusBar *>(param);
+  val.Dispose();
+  self->handle_.Clear();
+  delete self;
+}
+}
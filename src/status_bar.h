@@ -0,0 +1,90 @@
+// -*- C++ -*-
+// Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+//
+// A status bar draws named fields (e.g. the cursor position, the mode and the
+// clock) into a curses window. Scripts say where each field goes and set its
+// text; all of the padding and alignment happens natively. A field is only
+// drawn again when its text or attributes change, so updating the status bar
+// on every keypress is cheap when (as is usual) little of it has changed.
+
+#ifndef SRC_STATUS_BAR_H_
+#define SRC_STATUS_BAR_H_
+
+#include <stdint.h>
+#include <v8.h>
+
+#include <string>
+#include <vector>
+
+#include "./js_curses_window.h"
+
+using v8::Handle;
+using v8::Object;
+using v8::Persistent;
+using v8::Value;
+
+namespace e {
+class StatusBar {
+ public:
+  // A status bar drawing into window, whose script object (window_object) is
+  // kept alive for as long as the status bar is
+  StatusBar(JSCursesWindow *window, Handle<Object> window_object);
+  ~StatusBar();
+
+  // Define a field (or move an existing one) covering width columns of a row
+  // of the window, starting at column. Text that doesn't fill the field is
+  // padded with spaces drawn with fill_attrs, on the right or (if align_right
+  // is true) on the left.
+  void DefineField(const std::string &name, int row, int column, int width,
+                   int fill_attrs, bool align_right);
+
+  // Set the text (in UTF-16) and attributes of a field. Returns false if
+  // there's no field with the name.
+  bool SetField(const std::string &name, const uint16_t *text, size_t len,
+                int attrs);
+
+  // Mark every field as needing to be redrawn
+  void Invalidate();
+
+  // Draw the fields that have changed since they were last drawn. The cursor
+  // isn't moved. Returns the number of fields drawn.
+  int Repaint();
+
+  // The number of fields drawn by the last Repaint(), for debugging
+  inline int FieldsPainted() const { return fields_painted_; }
+
+  // Get the script object for a new status bar. The status bar is owned by
+  // the script object, and is deleted when it's garbage collected.
+  Handle<Value> ToScript();
+
+ private:
+  struct Field {
+    std::string name;
+    int row;
+    int column;
+    int width;
+    int fill_attrs;
+    bool align_right;
+    std::vector<uint16_t> text;
+    int attrs;
+    bool dirty;
+  };
+
+  JSCursesWindow *window_;
+  Persistent<Object> window_object_;
+  std::vector<Field> fields_;
+  int fields_painted_;
+  Persistent<Object> handle_;
+
+  Field *Find(const std::string &name);
+  void DrawField(const Field &field);
+
+  // Blank the cells a field covers with its fill attributes, and mark the
+  // other fields overlapping them as needing to be redrawn
+  void BlankField(const Field &field);
+
+  static void OnCollected(Persistent<Value>, void *);
+};
+}
+
+#endif  // SRC_STATUS_BAR_H_
@@ -0,0 +1,742 @@
+// Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+
+#include "./term_output.h"
+
+#include <errno.h>
+#include <term.h>
+#include <unistd.h>
+#include <wchar.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "./assert.h"
+#include "./curses_low_level.h"
+#include "./latency.h"
+#include "./logging.h"
+#include "./wcwidth.h"
+
+namespace {
+// the right half of a wide character
+const uint32_t kContinuation = 0;
+
+// a cell whose contents on the terminal aren't known
+const uint32_t kInvalid = 0xFFFFFFFF;
+
+// the most cells that will be rewritten to move the cursor right, rather than
+// moving it with an escape sequence (which is usually 6-8 bytes)
+const int kMaxGap = 4;
+
+// the fewest rows that have to be fixed by scrolling before the scrolling
+// capabilities are used
+const int kMinScrollRows = 3;
+
+// the attributes that are drawn (colors are kept separately)
+const uint32_t kAttrMask = static_cast<uint32_t>(A_ATTRIBUTES & ~A_COLOR);
+
+const char *GetCap(const char *name) {
+  char *s = tigetstr(const_cast<char *>(name));
+  if (s == nullptr || s == reinterpret_cast<char *>(-1)) {
+    return nullptr;
+  }
+  return s;
+}
+
+// tparm() returns a static buffer, so this must only be called from the
+// render thread.
+const char *Param(const char *cap, int a, int b = 0) {
+  return tparm(const_cast<char *>(cap), a, b);
+}
+
+void AppendUtf8(std::string *out, uint32_t ch) {
+  if (ch < 0x80) {
+    out->push_back(static_cast<char>(ch));
+  } else if (ch < 0x800) {
+    out->push_back(static_cast<char>(0xC0 | (ch >> 6)));
+    out->push_back(static_cast<char>(0x80 | (ch & 0x3F)));
+  } else if (ch < 0x10000) {
+    out->push_back(static_cast<char>(0xE0 | (ch >> 12)));
+    out->push_back(static_cast<char>(0x80 | ((ch >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (ch & 0x3F)));
+  } else {
+    out->push_back(static_cast<char>(0xF0 | (ch >> 18)));
+    out->push_back(static_cast<char>(0x80 | ((ch >> 12) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | ((ch >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (ch & 0x3F)));
+  }
+}
+
+// A hash of the cells of a row (FNV-1a, a cell at a time), to quickly find
+// rows that have moved
+template <typename C>
+uint64_t HashRow(const C *row, int cols) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (int i = 0; i < cols; i++) {
+    const uint64_t cell = row[i].ch ^
+        (static_cast<uint64_t>(row[i].attrs) << 16) ^
+        (static_cast<uint64_t>(static_cast<uint16_t>(row[i].fg)) << 40) ^
+        (static_cast<uint64_t>(static_cast<uint16_t>(row[i].bg)) << 48);
+    hash = (hash ^ cell) * 1099511628211ULL;
+  }
+  return hash;
+}
+}
+
+namespace e {
+TermOutput *direct_output = nullptr;
+
+TermOutput::TermOutput(int fd)
+    :fd_(fd), rows_(0), cols_(0), want_y_(-1), want_x_(-1), rendering_(false),
+     stop_(false), bytes_written_(0), front_rows_(0), front_cols_(0),
+     cleared_(false), cursor_y_(-1), cursor_x_(-1), attrs_known_(false),
+     attrs_(0), fg_(-1), bg_(-1) {
+  cup_ = GetCap("cup");
+  clear_ = GetCap("clear");
+  el_ = GetCap("el");
+  sgr0_ = GetCap("sgr0");
+  bold_ = GetCap("bold");
+  dim_ = GetCap("dim");
+  rev_ = GetCap("rev");
+  smso_ = GetCap("smso");
+  smul_ = GetCap("smul");
+  blink_ = GetCap("blink");
+  setaf_ = GetCap("setaf");
+  setab_ = GetCap("setab");
+  op_ = GetCap("op");
+  csr_ = GetCap("csr");
+  ind_ = GetCap("ind");
+  indn_ = GetCap("indn");
+  ri_ = GetCap("ri");
+  rin_ = GetCap("rin");
+  auto_margins_ = tigetflag(const_cast<char *>("am")) > 0;
+  ASSERT(cup_ != nullptr);
+  Resize(LINES, COLS);
+  thread_ = std::thread(&TermOutput::RenderLoop, this);
+}
+
+TermOutput::~TermOutput() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_all();
+  thread_.join();
+}
+
+void TermOutput::Resize(int rows, int cols) {
+  const Cell blank = {' ', 0, -1, -1};
+  rows_ = rows;
+  cols_ = cols;
+  back_.resize(rows);
+  for (int y = 0; y < rows; y++) {
+    back_[y].reset(new Row(cols, blank));
+  }
+  raw_.resize(rows * cols);
+  memset(raw_.data(), 0, raw_.size() * sizeof(raw_[0]));
+  invalid_.assign(rows, false);
+}
+
+// Get a row of the grid that can be changed. A row that's part of a frame is
+// copied first, since the render thread may be reading it.
+TermOutput::Row *TermOutput::WritableRow(int y) {
+  if (back_[y].use_count() > 1) {
+    back_[y].reset(new Row(*back_[y]));
+  }
+  return back_[y].get();
+}
+
+void TermOutput::Compose(WINDOW *win) {
+  if (rows_ != LINES || cols_ != COLS) {
+    Resize(LINES, COLS);
+  }
+  const int begy = getbegy(win);
+  const int begx = getbegx(win);
+  const int maxy = getmaxy(win);
+  const int maxx = getmaxx(win);
+  int cury, curx;
+  getyx(win, cury, curx);
+
+#ifdef USE_NCURSESW
+  static std::vector<cchar_t> line;
+#else
+  static std::vector<chtype> line;
+#endif
+  line.resize(maxx + 1);
+
+  for (int wy = 0; wy < maxy; wy++) {
+    const int y = begy + wy;
+    if (y < 0 || y >= rows_ || !is_linetouched(win, wy)) {
+      continue;
+    }
+    Row *row = nullptr;  // set once the first cell of the row changes
+#ifdef USE_NCURSESW
+    mvwin_wchnstr(win, wy, 0, line.data(), maxx);
+#else
+    mvwinchnstr(win, wy, 0, line.data(), maxx);
+#endif
+    // i is the position in line, which has one entry per character (so wide
+    // characters take up one entry, but two columns)
+    for (int i = 0, wx = 0; wx < maxx && begx + wx < cols_; i++, wx++) {
+      const int x = begx + wx;
+#ifdef USE_NCURSESW
+      const wchar_t wc = line[i].chars[0];
+      // (a cell never holds a control character, since curses draws those
+      // in caret notation, so the only narrow characters are one column)
+      const int width = wc < 0x300 ? 1 : std::max(CharWidth(wc), 1);
+#else
+      const int width = 1;
+#endif
+      if (memcmp(&line[i], &raw_[y * cols_ + x], sizeof(line[i])) == 0) {
+        wx += width - 1;
+        continue;
+      }
+      raw_[y * cols_ + x] = line[i];
+
+      // Color pairs are looked up here rather than when the cell is drawn, so
+      // that the render thread never has to call into curses.
+      Cell cell;
+      short pair;  // NOLINT
+#ifdef USE_NCURSESW
+      wchar_t wch[CCHARW_MAX + 1];
+      attr_t attrs;
+      getcchar(&line[i], wch, &attrs, &pair, nullptr);
+      cell.ch = static_cast<uint32_t>(wch[0]);
+      cell.attrs = static_cast<uint32_t>(attrs) & kAttrMask;
+#else
+      cell.ch = static_cast<uint32_t>(line[i] & A_CHARTEXT);
+      cell.attrs = static_cast<uint32_t>(line[i]) & kAttrMask;
+      pair = static_cast<short>(PAIR_NUMBER(line[i]));  // NOLINT
+#endif
+      short fg = -1, bg = -1;  // NOLINT
+      if (pair != 0) {
+        pair_content(pair, &fg, &bg);
+      }
+      cell.fg = fg;
+      cell.bg = bg;
+      if (cell.ch == kContinuation) {
+        cell.ch = ' ';
+      }
+      if ((*back_[y])[x] != cell) {
+        if (row == nullptr) {
+          row = WritableRow(y);
+        }
+        (*row)[x] = cell;
+      }
+      if (x + 1 >= cols_ || wx + 1 >= maxx) {
+        continue;
+      }
+      if (width == 2) {
+        // the right half of a wide character is a separate cell here
+        wx++;
+        cell.ch = kContinuation;
+        if ((*back_[y])[x + 1] != cell) {
+          if (row == nullptr) {
+            row = WritableRow(y);
+          }
+          (*row)[x + 1] = cell;
+        }
+      } else if ((*back_[y])[x + 1].ch == kContinuation) {
+        // this replaced a wide character, so the next cell has to be decoded
+        // even if it's the same as the last time it was decoded
+        memset(&raw_[y * cols_ + x + 1], 0, sizeof(raw_[0]));
+      }
+    }
+  }
+  wmove(win, cury, curx);
+  untouchwin(win);
+
+  if (!is_leaveok(win)) {
+    want_y_ = begy + cury;
+    want_x_ = begx + curx;
+  }
+}
+
+std::vector<std::string> TermOutput::ScreenText() const {
+  std::vector<std::string> text(rows_);
+  for (int y = 0; y < rows_; y++) {
+    for (const Cell &cell : *back_[y]) {
+      if (cell.ch == kContinuation) {
+        continue;
+      }
+      const bool printable = cell.ch >= 0x20 && cell.ch <= 0x10FFFF;
+      AppendUtf8(&text[y], printable ? cell.ch : '?');
+    }
+    text[y].erase(text[y].find_last_not_of(' ') + 1);
+  }
+  return text;
+}
+
+void TermOutput::Invalidate(int first, int count) {
+  first = std::max(first, 0);
+  const int last = std::min(first + count, rows_);
+  for (int y = first; y < last; y++) {
+    invalid_[y] = true;
+  }
+}
+
+void TermOutput::Flush() {
+  if (rows_ != LINES || cols_ != COLS) {
+    Resize(LINES, COLS);
+  }
+  std::shared_ptr<Frame> frame(new Frame);
+  frame->cols = cols_;
+  frame->rows.assign(back_.begin(), back_.end());
+  frame->invalid.swap(invalid_);
+  invalid_.assign(rows_, false);
+  frame->cursor_y = want_y_;
+  frame->cursor_x = want_x_;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (pending_ != nullptr && pending_->rows.size() == frame->rows.size()) {
+    // the render thread hasn't gotten to the last frame, so it's skipped; the
+    // rows it invalidated still have to be redrawn
+    for (size_t y = 0; y < frame->invalid.size(); y++) {
+      if (pending_->invalid[y]) {
+        frame->invalid[y] = true;
+      }
+    }
+  }
+  pending_ = frame;
+  cond_.notify_all();
+}
+
+void TermOutput::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (pending_ != nullptr || rendering_) {
+    cond_.wait(lock);
+  }
+}
+
+void TermOutput::RenderLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    while (pending_ == nullptr && !stop_) {
+      cond_.wait(lock);
+    }
+    if (pending_ == nullptr) {
+      break;  // stopped, and every frame has been drawn
+    }
+    std::shared_ptr<const Frame> frame(pending_);
+    pending_.reset();
+    rendering_ = true;
+    lock.unlock();
+    Render(*frame);
+    frame.reset();
+    lock.lock();
+    rendering_ = false;
+    cond_.notify_all();
+  }
+}
+
+void TermOutput::ResizeFront(int rows, int cols) {
+  const Cell invalid = {kInvalid, 0, -1, -1};
+  front_rows_ = rows;
+  front_cols_ = cols;
+  front_.assign(rows * cols, invalid);
+  shown_.assign(rows, std::shared_ptr<const Row>());
+  front_hash_.resize(rows);
+  front_hashed_.resize(rows);
+  HashFront(0, rows);
+  cleared_ = false;
+  cursor_y_ = -1;
+  attrs_known_ = false;
+}
+
+void TermOutput::HashFront(int first, int last) {
+  for (int y = first; y < last; y++) {
+    front_hash_[y] = HashRow(&front_[y * front_cols_], front_cols_);
+    front_hashed_[y] = true;
+  }
+}
+
+void TermOutput::Render(const Frame &frame) {
+  const int rows = static_cast<int>(frame.rows.size());
+  if (rows != front_rows_ || frame.cols != front_cols_) {
+    ResizeFront(rows, frame.cols);
+  }
+  out_.clear();
+  if (!cleared_ && clear_ != nullptr) {
+    const Cell blank = {' ', 0, -1, -1};
+    SetAttrs(0, -1, -1);
+    Emit(clear_);
+    std::fill(front_.begin(), front_.end(), blank);
+    HashFront(0, rows);
+    cursor_y_ = 0;
+    cursor_x_ = 0;
+  }
+  cleared_ = true;
+
+  // a row has to be drawn if it isn't the same row as in the last frame
+  std::vector<bool> dirty(rows);
+  int num_dirty = 0;
+  for (int y = 0; y < rows; y++) {
+    if (frame.invalid[y]) {
+      for (int x = 0; x < front_cols_; x++) {
+        front_[y * front_cols_ + x].ch = kInvalid;
+      }
+      HashFront(y, y + 1);
+    }
+    dirty[y] = frame.invalid[y] || frame.rows[y] != shown_[y];
+    num_dirty += dirty[y];
+  }
+  if (num_dirty >= kMinScrollRows) {
+    ScrollRows(frame, &dirty);
+  }
+  for (int y = 0; y < rows; y++) {
+    if (dirty[y]) {
+      DrawRow(*frame.rows[y], y);
+      front_hashed_[y] = false;
+    }
+  }
+  shown_ = frame.rows;
+  if (frame.cursor_y >= 0 && frame.cursor_y < rows) {
+    MoveTo(frame.cursor_y,
+           std::min(std::max(frame.cursor_x, 0), front_cols_ - 1));
+  }
+
+  // everything goes out in one write, unless the terminal can't take it all
+  // at once
+  const char *p = out_.data();
+  size_t remaining = out_.size();
+  while (remaining > 0) {
+    ssize_t n = write(fd_, p, remaining);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG(ERROR, "failed to write to terminal: %s", strerror(errno));
+      break;
+    }
+    p += n;
+    remaining -= n;
+    bytes_written_ += n;
+    if (fd_ == TerminalFd()) {
+      CountTerminalBytes(static_cast<size_t>(n));
+    }
+  }
+}
+
+void TermOutput::Emit(const char *s) {
+  if (s != nullptr) {
+    out_.append(s);
+  }
+}
+
+void TermOutput::EmitChar(uint32_t ch) {
+  if (ch < 0x20 || ch == 0x7F || ch > 0x10FFFF) {
+    ch = '?';
+  }
+  AppendUtf8(&out_, ch);
+}
+
+void TermOutput::MoveTo(int y, int x) {
+  if (cursor_y_ == y && cursor_x_ == x) {
+    return;
+  }
+  if (cursor_y_ == y && cursor_x_ < x && x - cursor_x_ <= kMaxGap &&
+      attrs_known_) {
+    // The cells between the cursor and x are already up to date on the
+    // terminal; if they're narrow characters with the current attributes,
+    // writing them again is shorter than moving the cursor.
+    const Cell *row = &front_[y * front_cols_];
+    bool rewrite = true;
+    for (int i = cursor_x_; i < x; i++) {
+      if (row[i].ch == kContinuation || row[i].ch == kInvalid ||
+          row[i + 1].ch == kContinuation || row[i].attrs != attrs_ ||
+          row[i].fg != fg_ || row[i].bg != bg_) {
+        rewrite = false;
+        break;
+      }
+    }
+    if (rewrite) {
+      for (int i = cursor_x_; i < x; i++) {
+        EmitChar(row[i].ch);
+      }
+      cursor_x_ = x;
+      return;
+    }
+  }
+  Emit(Param(cup_, y, x));
+  cursor_y_ = y;
+  cursor_x_ = x;
+}
+
+void TermOutput::SetAttrs(uint32_t attrs, int16_t fg, int16_t bg) {
+  if (attrs_known_ && attrs == attrs_) {
+    SetColors(fg, bg);
+    return;
+  }
+  Emit(sgr0_);
+  if (attrs & A_BOLD) {
+    Emit(bold_);
+  }
+  if (attrs & A_DIM) {
+    Emit(dim_);
+  }
+  if (attrs & A_REVERSE) {
+    Emit(rev_);
+  }
+  if (attrs & A_STANDOUT) {
+    Emit(smso_ != nullptr ? smso_ : rev_);
+  }
+  if (attrs & A_UNDERLINE) {
+    Emit(smul_);
+  }
+  if (attrs & A_BLINK) {
+    Emit(blink_);
+  }
+  attrs_known_ = true;
+  attrs_ = attrs;
+  fg_ = -1;  // sgr0 also resets the colors
+  bg_ = -1;
+  SetColors(fg, bg);
+}
+
+// Change the colors, leaving the other attributes alone
+void TermOutput::SetColors(int16_t fg, int16_t bg) {
+  if (fg == fg_ && bg == bg_) {
+    return;
+  }
+  if ((fg < 0 && fg_ >= 0) || (bg < 0 && bg_ >= 0)) {
+    // there's no way to set just one color back to the default
+    Emit(op_);
+    fg_ = -1;
+    bg_ = -1;
+  }
+  if (fg >= 0 && fg != fg_ && setaf_ != nullptr) {
+    Emit(Param(setaf_, fg));
+  }
+  if (bg >= 0 && bg != bg_ && setab_ != nullptr) {
+    Emit(Param(setab_, bg));
+  }
+  fg_ = fg;
+  bg_ = bg;
+}
+
+// If a block of rows has moved up or down (e.g. because the buffer window was
+// scrolled), move it on the terminal with a scroll region rather than drawing
+// every row again.
+void TermOutput::ScrollRows(const Frame &frame, std::vector<bool> *dirty) {
+  const int rows = front_rows_;
+  if (csr_ == nullptr || rows < kMinScrollRows) {
+    return;
+  }
+  // rows that aren't dirty are the same in the frame and on the terminal
+  for (int y = 0; y < rows; y++) {
+    if (!front_hashed_[y]) {
+      HashFront(y, y + 1);
+    }
+  }
+  std::vector<uint64_t> back_hash(front_hash_);
+  for (int y = 0; y < rows; y++) {
+    if ((*dirty)[y]) {
+      back_hash[y] = HashRow(frame.rows[y]->data(), front_cols_);
+    }
+  }
+  const std::vector<uint64_t> &front_hash = front_hash_;
+
+  // only distances that at least kMinScrollRows dirty rows have moved by are
+  // worth looking at
+  std::vector<int> votes(2 * rows);
+  for (int y = 0; y < rows; y++) {
+    if (!(*dirty)[y] || back_hash[y] == front_hash[y]) {
+      continue;
+    }
+    for (int from = 0; from < rows; from++) {
+      if (back_hash[y] == front_hash[from]) {
+        votes[from - y + rows]++;
+      }
+    }
+  }
+
+  // For each distance that rows could have moved by, find the run of rows
+  // where scrolling would help the most: a row counts for scrolling if it
+  // would then be up to date, and against it if it's up to date now but
+  // wouldn't be after scrolling.
+  int best_shift = 0;
+  int best_first = 0;
+  int best_count = 0;
+  int best_score = 0;
+  for (int shift = 1 - rows; shift < rows; shift++) {
+    if (shift == 0 || votes[shift + rows] < kMinScrollRows) {
+      continue;
+    }
+    int first = std::max(0, -shift);
+    const int end = std::min(rows, rows - shift);
+    int score = 0;
+    for (int y = first; y < end; y++) {
+      const bool now = back_hash[y] == front_hash[y];
+      const bool moved = back_hash[y] == front_hash[y + shift];
+      if (moved && !now) {
+        score++;
+      } else if (now && !moved) {
+        score--;
+      }
+      if (score <= 0) {
+        score = 0;
+        first = y + 1;
+      } else if (score > best_score) {
+        best_shift = shift;
+        best_first = first;
+        best_count = y - first + 1;
+        best_score = score;
+      }
+    }
+  }
+  if (best_score < kMinScrollRows) {
+    return;
+  }
+
+  const int n = std::abs(best_shift);
+  int top, bot;
+  if (best_shift > 0) {
+    if (ind_ == nullptr && indn_ == nullptr) {
+      return;
+    }
+    top = best_first;
+    bot = best_first + best_count - 1 + n;
+  } else {
+    if (ri_ == nullptr && rin_ == nullptr) {
+      return;
+    }
+    top = best_first - n;
+    bot = best_first + best_count - 1;
+  }
+
+  // the rows scrolled in are cleared with the current background color
+  SetAttrs(0, -1, -1);
+  Emit(Param(csr_, top, bot));
+  cursor_y_ = -1;
+  if (best_shift > 0) {
+    MoveTo(bot, 0);
+    if (indn_ != nullptr && (n > 1 || ind_ == nullptr)) {
+      Emit(Param(indn_, n));
+    } else {
+      for (int i = 0; i < n; i++) {
+        Emit(ind_);
+      }
+    }
+  } else {
+    MoveTo(top, 0);
+    if (rin_ != nullptr && (n > 1 || ri_ == nullptr)) {
+      Emit(Param(rin_, n));
+    } else {
+      for (int i = 0; i < n; i++) {
+        Emit(ri_);
+      }
+    }
+  }
+  Emit(Param(csr_, 0, rows - 1));
+  cursor_y_ = -1;
+
+  const int cols = front_cols_;
+  const Cell blank = {' ', 0, -1, -1};
+  std::fill(dirty->begin() + top, dirty->begin() + bot + 1, true);
+  std::vector<Cell>::iterator front = front_.begin();
+  if (best_shift > 0) {
+    for (int y = top; y <= bot; y++) {
+      if (y + n <= bot) {
+        std::copy(front + (y + n) * cols, front + (y + n + 1) * cols,
+                  front + y * cols);
+      } else {
+        std::fill(front + y * cols, front + (y + 1) * cols, blank);
+      }
+    }
+  } else {
+    for (int y = bot; y >= top; y--) {
+      if (y - n >= top) {
+        std::copy(front + (y - n) * cols, front + (y - n + 1) * cols,
+                  front + y * cols);
+      } else {
+        std::fill(front + y * cols, front + (y + 1) * cols, blank);
+      }
+    }
+  }
+  HashFront(top, bot + 1);
+}
+
+void TermOutput::DrawRow(const Row &row, int y) {
+  const int cols = front_cols_;
+  const Cell *back = row.data();
+  Cell *front = &front_[y * cols];
+
+  // writing the bottom right corner would scroll the screen on terminals with
+  // automatic margins, so it's left alone
+  const int last = (y == front_rows_ - 1 && auto_margins_) ? cols - 1 : cols;
+
+  // everything from blank_from to the end of the row is blank, and can be
+  // drawn by clearing to the end of the line
+  int blank_from = cols;
+  while (blank_from > 0 && back[blank_from - 1].ch == ' ' &&
+         back[blank_from - 1].attrs == 0 && back[blank_from - 1].fg < 0 &&
+         back[blank_from - 1].bg < 0) {
+    blank_from--;
+  }
+
+  int x = 0;
+  while (x < last) {
+    if (back[x] == front[x]) {
+      x++;
+      continue;
+    }
+    if (back[x].ch == kContinuation && x > 0) {
+      x--;  // the wide character this is part of has to be drawn again
+    }
+    if (x >= blank_from && el_ != nullptr &&
+        cols - x > static_cast<int>(strlen(el_))) {
+      MoveTo(y, x);
+      SetAttrs(0, -1, -1);
+      Emit(el_);
+      std::copy(back + x, back + cols, front + x);
+      break;
+    }
+    const int width =
+        (x + 1 < cols && back[x + 1].ch == kContinuation) ? 2 : 1;
+    if (x + width > last) {
+      break;
+    }
+    MoveTo(y, x);
+    SetAttrs(back[x].attrs, back[x].fg, back[x].bg);
+    EmitChar(back[x].ch == kContinuation ? ' ' : back[x].ch);
+    std::copy(back + x, back + x + width, front + x);
+    x += width;
+    cursor_x_ += width;
+    if (cursor_x_ >= cols) {
+      cursor_y_ = -1;  // the terminal may or may not have wrapped
+    }
+  }
+}
+
+void EndDirectOutput() {
+  delete direct_output;
+  direct_output = nullptr;
+}
+
+int NoutRefresh(WINDOW *win) {
+  if (direct_output != nullptr) {
+    direct_output->Compose(win);
+    return OK;
+  }
+  return wnoutrefresh(win);
+}
+
+int DoUpdate() {
+  int ret = OK;
+  if (direct_output != nullptr) {
+    direct_output->Flush();
+  } else {
+    ret = doupdate();
+  }
+  latency.UpdateDone();
+  return ret;
+}
+
+int RedrawLines(WINDOW *win, int first, int count) {
+  if (direct_output != nullptr) {
+    direct_output->Invalidate(getbegy(win) + first, count);
+    return OK;
+  }
+  return wredrawln(win, first, count);
+}
+}
@@ -0,0 +1,219 @@
+// -*- C++ -*-
+// Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+//
+// A terminal output backend that can be used instead of ncurses' doupdate().
+// Scripts still draw into curses windows (which only changes memory), but the
+// windows are copied into a grid of cells owned by the backend rather than
+// into ncurses' virtual screen.
+//
+// Updating the screen takes an immutable snapshot of the grid (a frame) and
+// hands it to a render thread, so that the main thread can go back to handling
+// input while the frame is written. The render thread diffs the frame against
+// what the terminal is showing, and writes the escape sequences for the
+// differences (from terminfo strings looked up once) into a single buffer,
+// which is written to the terminal with one write(2). If frames come in faster
+// than the terminal takes them, the render thread skips to the newest one.
+//
+// The backend is enabled with --direct-output (and is always used with
+// --headless, where it draws to /dev/null); code that would call
+// wnoutrefresh() or doupdate() should call NoutRefresh() and DoUpdate() below,
+// which go to whichever backend is in use.
+
+#ifndef SRC_TERM_OUTPUT_H_
+#define SRC_TERM_OUTPUT_H_
+
+#include <stdint.h>
+
+#ifdef USE_NCURSESW
+#ifdef PLATFORM_LINUX
+#ifndef _XOPEN_SOURCE_EXTENDED
+#define _XOPEN_SOURCE_EXTENDED
+#endif  // _X_OPEN_SOURCE_EXTENDED
+#include <ncursesw/curses.h>
+#else
+#include <curses.h>
+#endif  // PLATFORM_LINUX
+#else  // USE_NCURSESW
+#include <curses.h>  // NOLINT
+#endif  // USE_NCURSESW
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace e {
+class TermOutput {
+ public:
+  // Create a backend writing to fd, and start its render thread. The terminfo
+  // entry for the terminal must already be loaded (i.e. by initscr() or
+  // newterm()).
+  explicit TermOutput(int fd);
+
+  // Write the last frame, and stop the render thread
+  ~TermOutput();
+
+  // Copy the lines of a window that have changed since it was last composed
+  // into the grid, and leave the cursor where the window's cursor is; this is
+  // the equivalent of wnoutrefresh().
+  void Compose(WINDOW *win);
+
+  // Hand the grid to the render thread to be drawn; this is the equivalent of
+  // doupdate(), except that it returns without waiting for the output.
+  void Flush();
+
+  // Wait until every frame handed to the render thread has been written
+  void Wait();
+
+  // Forget what's on count rows of the terminal starting at first, so that
+  // the next frame redraws them.
+  void Invalidate(int first, int count);
+
+  // The text on each row of the screen, as composed so far, in UTF-8 and with
+  // trailing spaces removed
+  std::vector<std::string> ScreenText() const;
+
+  // The number of bytes written to the terminal so far
+  inline size_t BytesWritten() const { return bytes_written_; }
+
+ private:
+  struct Cell {
+    uint32_t ch;  // the code point, or one of the special values in the .cc
+    uint32_t attrs;
+    int16_t fg;  // -1 is the terminal's default color
+    int16_t bg;
+
+    inline bool operator==(const Cell &other) const {
+      return (ch == other.ch && attrs == other.attrs && fg == other.fg &&
+              bg == other.bg);
+    }
+    inline bool operator!=(const Cell &other) const {
+      return !(*this == other);
+    }
+  };
+  typedef std::vector<Cell> Row;
+
+  // A snapshot of the grid. Rows are never changed once they're in a frame,
+  // so consecutive frames share the rows that are the same in both.
+  struct Frame {
+    int cols;
+    std::vector<std::shared_ptr<const Row> > rows;
+    std::vector<bool> invalid;  // rows to redraw from scratch
+    int cursor_y;  // negative to leave the cursor wherever it ends up
+    int cursor_x;
+  };
+
+  int fd_;
+
+  // Only used by the main thread: the grid, the curses cells that each cell
+  // of the grid was last decoded from (so that only cells that have changed
+  // are decoded again), the rows invalidated since the last frame, and where
+  // the cursor should be left.
+  int rows_;
+  int cols_;
+  std::vector<std::shared_ptr<Row> > back_;
+#ifdef USE_NCURSESW
+  std::vector<cchar_t> raw_;
+#else
+  std::vector<chtype> raw_;
+#endif
+  std::vector<bool> invalid_;
+  int want_y_;
+  int want_x_;
+
+  // Shared by both threads, and guarded by mutex_ (except for the atomic)
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::shared_ptr<Frame> pending_;  // the next frame to draw
+  bool rendering_;  // true while the render thread is drawing a frame
+  bool stop_;
+  std::atomic<size_t> bytes_written_;
+
+  // Only used by the render thread: the rows of the last frame drawn, what
+  // the terminal is showing, and a hash of each row of that (which is only
+  // brought up to date when it's needed, i.e. when front_hashed_ is false for
+  // a row, its hash is stale).
+  std::vector<std::shared_ptr<const Row> > shown_;
+  int front_rows_;
+  int front_cols_;
+  std::vector<Cell> front_;
+  std::vector<uint64_t> front_hash_;
+  std::vector<bool> front_hashed_;
+  bool cleared_;  // false until the screen has been cleared
+
+  // the terminal's cursor position (a negative row if it isn't known)
+  int cursor_y_;
+  int cursor_x_;
+
+  // the terminal's current attributes, if attrs_known_ is true
+  bool attrs_known_;
+  uint32_t attrs_;
+  int16_t fg_;
+  int16_t bg_;
+
+  std::string out_;
+
+  // terminfo strings and flags, looked up when the backend is created; any
+  // string the terminal doesn't have is null
+  const char *cup_;
+  const char *clear_;
+  const char *el_;
+  const char *sgr0_;
+  const char *bold_;
+  const char *dim_;
+  const char *rev_;
+  const char *smso_;
+  const char *smul_;
+  const char *blink_;
+  const char *setaf_;
+  const char *setab_;
+  const char *op_;
+  const char *csr_;
+  const char *ind_;
+  const char *indn_;
+  const char *ri_;
+  const char *rin_;
+  bool auto_margins_;
+
+  std::thread thread_;
+
+  // main thread
+  void Resize(int rows, int cols);
+  Row *WritableRow(int y);
+
+  // render thread
+  void RenderLoop();
+  void Render(const Frame &frame);
+  void ResizeFront(int rows, int cols);
+  void Emit(const char *s);
+  void EmitChar(uint32_t ch);
+  void MoveTo(int y, int x);
+  void SetAttrs(uint32_t attrs, int16_t fg, int16_t bg);
+  void SetColors(int16_t fg, int16_t bg);
+  void HashFront(int first, int last);
+  void ScrollRows(const Frame &frame, std::vector<bool> *dirty);
+  void DrawRow(const Row &back, int y);
+};
+
+// The direct output backend, if --direct-output or --headless was given
+// (otherwise null)
+extern TermOutput *direct_output;
+
+// Finish writing to the terminal, and delete the direct output backend
+void EndDirectOutput();
+
+// Copy a window to the screen drawn by the next DoUpdate(), like wnoutrefresh()
+int NoutRefresh(WINDOW *win);
+
+// Update the terminal, like doupdate()
+int DoUpdate();
+
+// Redraw count lines of a window from scratch at the next update, like
+// wredrawln()
+int RedrawLines(WINDOW *win, int first, int count);
+}
+
+#endif  // SRC_TERM_OUTPUT_H_
@@ -4,8 +4,12 @@
 #define BOOST_TEST_DYN_LINK
 #include <boost/test/unit_test.hpp>
 
+#include "../buffer.h"
+#include "../keymap.h"
+#include "../latency.h"
 #include "../line.h"
 #include "../logging.h"
+#include "../utf8.h"
 
 class GlobalConfig {
  public:
@@ -80,3 +84,272 @@ BOOST_AUTO_TEST_CASE(append_test) {
   l.Append(bar_chars, 3);
   CheckString(l, "foobar");
 }
+
+BOOST_AUTO_TEST_CASE(version_test) {
+  e::Line l("foo");
+  uint32_t version = l.Version();
+
+  l.InsertChar(l.Size(), 'd');
+  BOOST_CHECK(l.Version() != version);
+  version = l.Version();
+
+  l.Erase(0, 1);
+  BOOST_CHECK(l.Version() != version);
+  version = l.Version();
+
+  l.ToString();
+  BOOST_CHECK(l.Version() == version);
+}
+
+BOOST_AUTO_TEST_CASE(utf8_line_test) {
+  // "h\u00e9llo" is six bytes of UTF-8, but only five characters
+  e::Line l("h\xc3\xa9llo");
+  BOOST_CHECK(l.Size() == 5);
+  BOOST_CHECK(l.ToString() == "h\xc3\xa9llo");
+
+  // code points outside the BMP are stored as surrogate pairs
+  l.Replace("\xf0\x9f\x98\x80");
+  BOOST_CHECK(l.Size() == 2);
+  BOOST_CHECK(l.ToString() == "\xf0\x9f\x98\x80");
+
+  // invalid UTF-8 is stored one character per byte
+  l.Replace("a\xff");
+  BOOST_CHECK(l.Size() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(utf8_validation_test) {
+  BOOST_CHECK(e::IsValidUtf8("", 0));
+  BOOST_CHECK(e::IsValidUtf8("0123456789abcdef\xe4\xb8\xad", 19));
+  BOOST_CHECK(!e::IsValidUtf8("\xc0\x80", 2));  // overlong
+  BOOST_CHECK(!e::IsValidUtf8("\xed\xa0\x80", 3));  // surrogate
+  BOOST_CHECK(!e::IsValidUtf8("\xf4\x90\x80\x80", 4));  // past U+10FFFF
+  BOOST_CHECK(!e::IsValidUtf8("\xe2\x82", 2));  // truncated
+
+  // unpaired surrogates are encoded as U+FFFD
+  uint16_t chars[3] = {'a', 0xD800, 'b'};
+  std::string s;
+  e::Utf16ToUtf8(chars, 3, &s);
+  BOOST_CHECK(s == "a\xef\xbf\xbd" "b");
+  BOOST_CHECK(e::Utf8Length(chars, 3) == s.size());
+}
+
+BOOST_AUTO_TEST_CASE(column_test) {
+  // tabs expand to the next tab stop
+  e::Line l("a\tb");
+  BOOST_CHECK(l.ColumnOf(1) == 1);
+  BOOST_CHECK(l.ColumnOf(2) == TAB_SIZE);
+  BOOST_CHECK(l.DisplayWidth() == TAB_SIZE + 1);
+  BOOST_CHECK(l.IndexAt(2) == 1);  // in the middle of the tab
+
+  // wide characters take two columns, combining characters take none
+  l.Replace("\xe4\xb8\xad" "e\xcc\x81x");
+  BOOST_CHECK(l.ColumnOf(1) == 2);
+  BOOST_CHECK(l.ColumnOf(3) == 3);
+  BOOST_CHECK(l.DisplayWidth() == 4);
+  BOOST_CHECK(l.IndexAt(1) == 0);
+  BOOST_CHECK(l.IndexAt(2) == 1);
+  BOOST_CHECK(l.IndexAt(3) == 3);
+  BOOST_CHECK(l.IndexAt(10) == l.Size());
+
+  // a trailing combining mark isn't drawn past the end of the line
+  l.Replace("e\xcc\x81");
+  BOOST_CHECK(l.DisplayWidth() == 1);
+  BOOST_CHECK(l.IndexAt(0) == 0);
+  BOOST_CHECK(l.IndexAt(1) == l.Size());
+
+  // a character outside the BMP is a surrogate pair, which is one character
+  l.Replace("a\xf0\x9f\x98\x80" "b");
+  BOOST_CHECK(l.Size() == 4);
+  BOOST_CHECK(l.IndexAt(1) == 1);
+  BOOST_CHECK(l.IndexAt(2) == 1);
+  BOOST_CHECK(l.IndexAt(3) == 3);
+
+  // the table is rebuilt after edits
+  l.InsertChar(0, '\t');
+  BOOST_CHECK(l.ColumnOf(1) == TAB_SIZE);
+}
+
+BOOST_AUTO_TEST_CASE(buffer_offset_test) {
+  e::Buffer b("test");
+  b[0]->Replace("ab");
+  b.AppendLine("\xe4\xb8\xad");
+  b.AppendLine("");
+  BOOST_CHECK(b.OffsetOfLine(0) == 0);
+  BOOST_CHECK(b.OffsetOfLine(1) == 3);
+  BOOST_CHECK(b.OffsetOfLine(2) == 7);
+  BOOST_CHECK(b.OffsetOfLine(3) == 8);
+  BOOST_CHECK(b.LineOfOffset(2) == 0);
+  BOOST_CHECK(b.LineOfOffset(3) == 1);
+  BOOST_CHECK(b.LineOfOffset(100) == 2);
+
+  // edits within a line, and inserting and erasing lines
+  b[1]->InsertChar(1, 'x');
+  BOOST_CHECK(b.OffsetOfLine(2) == 8);
+  b.Insert(0, "0123");
+  BOOST_CHECK(b.OffsetOfLine(3) == 13);
+  b.Erase(1);
+  b[0]->Chop(0);
+  BOOST_CHECK(b.OffsetOfLine(1) == 1);
+  BOOST_CHECK(b.LineOfOffset(1) == 1);
+
+  // lots of lines inserted and erased in the middle
+  for (int i = 0; i < 200; i++) {
+    b.Insert(1, std::string(i % 7, 'x'));
+  }
+  b.Erase(50, 100);
+  b[60]->InsertChar(0, 'y');
+  size_t offset = 0;
+  for (size_t i = 0; i < b.Size(); i++) {
+    BOOST_CHECK(b.OffsetOfLine(i) == offset);
+    BOOST_CHECK(b.LineOfOffset(offset) == i);
+    offset += b[i]->Utf8Size() + 1;
+  }
+  BOOST_CHECK(b.OffsetOfLine(b.Size()) == offset);
+
+  e::Line *l = b[70];
+  b.Insert(0, "");
+  b.Erase(10, 5);
+  BOOST_CHECK(b.IndexOf(l) == 66);
+  BOOST_CHECK(b[66] == l);
+
+  b.Erase(0, b.Size());
+  BOOST_CHECK(b.OffsetOfLine(0) == 0);
+  BOOST_CHECK(b.LineOfOffset(5) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(buffer_insert_text_test) {
+  e::Buffer b("test");
+  b[0]->Replace("ad");
+  const uint16_t text[] = {'b', '\r', '\n', 'x', '\n', '\n', 'c'};
+  std::pair<size_t, size_t> end = b.InsertText(0, 1, text, 7);
+  BOOST_CHECK(end.first == 3);
+  BOOST_CHECK(end.second == 1);
+  BOOST_CHECK(b.Size() == 4);
+  BOOST_CHECK(b[0]->ToString() == "ab");
+  BOOST_CHECK(b[1]->ToString() == "x");
+  BOOST_CHECK(b[2]->ToString() == "");
+  BOOST_CHECK(b[3]->ToString() == "cd");
+  BOOST_CHECK(b.OffsetOfLine(3) == 6);
+}
+
+BOOST_AUTO_TEST_CASE(buffer_motion_test) {
+  e::Buffer b("test");
+  b[0]->Replace("foo bar.baz  qux");
+  b.AppendLine("");
+  b.AppendLine("  hello, world");
+  BOOST_CHECK(b.LineDown(0, 100000) == 2);
+  BOOST_CHECK(b.LineUp(2, 1) == 1);
+  BOOST_CHECK(b.LineUp(2, 100000) == 0);
+
+  std::pair<size_t, size_t> pos = b.WordForward(0, 0, 3);
+  BOOST_CHECK(pos.first == 0 && pos.second == 8);
+  pos = b.WordForward(0, 13, 1);  // an empty line is a word
+  BOOST_CHECK(pos.first == 1 && pos.second == 0);
+  pos = b.WordForward(0, 0, 100);  // stops on the last character
+  BOOST_CHECK(pos.first == 2 && pos.second == 13);
+  pos = b.WordBackward(2, 13, 3);
+  BOOST_CHECK(pos.first == 2 && pos.second == 2);
+  pos = b.WordBackward(2, 2, 2);
+  BOOST_CHECK(pos.first == 0 && pos.second == 13);
+  pos = b.WordBackward(0, 5, 100);
+  BOOST_CHECK(pos.first == 0 && pos.second == 0);
+
+  BOOST_CHECK(b.GotoLine(1) == 1);
+  BOOST_CHECK(b.GotoLine(100) == 2);
+  BOOST_CHECK(b.LineStart(2) == 2);
+  BOOST_CHECK(b.LineStart(1) == 0);
+  pos = b.LineEnd(0, 1);
+  BOOST_CHECK(pos.first == 0 && pos.second == 15);
+  pos = b.LineEnd(0, 2);  // an empty line ends at column 0
+  BOOST_CHECK(pos.first == 1 && pos.second == 0);
+
+  // lines can be erased all at once
+  b.Erase(0, 2);
+  BOOST_CHECK(b.Size() == 1);
+  BOOST_CHECK(b[0]->ToString() == "  hello, world");
+  BOOST_CHECK(b.OffsetOfLine(1) == 15);
+
+  // motions in an empty buffer stay at the start
+  b.Erase(0, 1);
+  BOOST_CHECK(b.LineDown(0, 5) == 0);
+  pos = b.WordForward(0, 0, 1);
+  BOOST_CHECK(pos.first == 0 && pos.second == 0);
+  pos = b.WordBackward(0, 0, 1);
+  BOOST_CHECK(pos.first == 0 && pos.second == 0);
+}
+
+BOOST_AUTO_TEST_CASE(histogram_test) {
+  e::Histogram h;
+  BOOST_CHECK(h.Percentile(50) == 0);
+  for (uint64_t i = 1; i <= 1000; i++) {
+    h.Record(i * 1000);
+  }
+  BOOST_CHECK(h.Count() == 1000);
+  BOOST_CHECK(h.Max() == 1000000);
+  BOOST_CHECK(h.Mean() == 500500);
+
+  // percentiles are only accurate to within the width of a bucket (1/16th)
+  uint64_t p50 = h.Percentile(50);
+  BOOST_CHECK(p50 >= 500000 && p50 < 500000 + 500000 / 16);
+  uint64_t p99 = h.Percentile(99);
+  BOOST_CHECK(p99 >= 990000 && p99 <= 1000000);
+  BOOST_CHECK(h.Percentile(100) == 1000000);
+
+  // small values are exact
+  h.Reset();
+  h.Record(3);
+  h.Record(7);
+  BOOST_CHECK(h.Percentile(50) == 3);
+  BOOST_CHECK(h.Percentile(100) == 7);
+}
+
+BOOST_AUTO_TEST_CASE(keymap_test) {
+  typedef e::Keymap::Key Key;
+  e::Keymap km(1000);
+  const Key g = e::Keymap::MakeKey('g', false);
+  const Key x = e::Keymap::MakeKey('x', false);
+  const Key home = e::Keymap::MakeKey('g', true);  // a keypad key
+  e::Keymap::ModeId command = km.Intern("command");
+  BOOST_CHECK(km.Intern("command") == command);
+  BOOST_CHECK(km.Bind(command, std::vector<Key>(1, g), 1) == 0);
+  BOOST_CHECK(km.Bind(command, std::vector<Key>(2, g), 2) == 0);
+  BOOST_CHECK(km.Bind(command, std::vector<Key>(1, home), 3) == 0);
+  km.SetMode(command);
+  BOOST_CHECK(km.StartsSequence(g) && km.StartsSequence(home));
+  BOOST_CHECK(!km.StartsSequence(x));
+  BOOST_CHECK(km.Timeout() == 1000);
+
+  int binding, flushed;
+  BOOST_CHECK(km.Feed(home, 0, &binding, &flushed) == e::Keymap::BOUND);
+  BOOST_CHECK(binding == 3 && flushed == 0);
+
+  // "gg" is bound, and so is its prefix "g"
+  BOOST_CHECK(km.Feed(g, 0, &binding, &flushed) == e::Keymap::PENDING);
+  BOOST_CHECK(km.PendingLength() == 1);
+  BOOST_CHECK(km.Feed(g, 0, &binding, &flushed) == e::Keymap::BOUND);
+  BOOST_CHECK(binding == 2 && flushed == 0);
+
+  // a key that breaks the sequence runs "g" first
+  BOOST_CHECK(km.Feed(g, 0, &binding, &flushed) == e::Keymap::PENDING);
+  BOOST_CHECK(km.Feed(x, 0, &binding, &flushed) == e::Keymap::UNBOUND);
+  BOOST_CHECK(binding == 0 && flushed == 1);
+
+  // and so does the timeout
+  BOOST_CHECK(km.Feed(g, 0, &binding, &flushed) == e::Keymap::PENDING);
+  BOOST_CHECK(km.Feed(g, 2000000000, &binding, &flushed) ==
+              e::Keymap::PENDING);
+  BOOST_CHECK(flushed == 1);
+  BOOST_CHECK(km.Flush() == 1);
+
+  // once "g" is unbound, "gx" is just unbound
+  BOOST_CHECK(km.Unbind(command, std::vector<Key>(1, g)) == 1);
+  BOOST_CHECK(km.Feed(g, 0, &binding, &flushed) == e::Keymap::PENDING);
+  BOOST_CHECK(km.Feed(x, 0, &binding, &flushed) == e::Keymap::UNBOUND);
+  BOOST_CHECK(binding == 0 && flushed == 0);
+
+  // keys are only bound in their mode
+  BOOST_CHECK(km.Unbind(command, std::vector<Key>(2, g)) == 2);
+  BOOST_CHECK(km.Feed(g, 0, &binding, &flushed) == e::Keymap::UNBOUND);
+  km.SetMode(km.Intern("insert"));
+  BOOST_CHECK(km.Feed(home, 0, &binding, &flushed) == e::Keymap::UNBOUND);
+}
@@ -11,6 +11,7 @@
 #include "./assert.h"
 #include "./io_service.h"
 #include "./js.h"
+#include "./watchdog.h"
 
 using v8::Boolean;
 using v8::Date;
@@ -144,7 +145,10 @@ bool Timer::Fire() {
   HandleScope scope;
   TryCatch tr;
   Local<Object> this_argument = Object::New();
-  func_->CallAsFunction(this_argument, 0, nullptr);
+  {
+    WatchdogScope watchdog_scope("timer");
+    func_->CallAsFunction(this_argument, 0, nullptr);
+  }
   HandleError(tr);
   if (repeat_) {
     timer_.expires_at(timer_.expires_at() +
@@ -0,0 +1,246 @@
+// Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+
+#include "./utf8.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <string>
+#include <vector>
+
+namespace {
+inline bool IsContinuation(uint8_t b) {
+  return (b & 0xC0) == 0x80;
+}
+
+// Decode the (non-ASCII) UTF-8 sequence starting at p. Returns the number of
+// bytes consumed and stores the code point in cp, or returns 0 if the sequence
+// is malformed.
+inline size_t DecodeSequence(const uint8_t *p, const uint8_t *end,
+                             uint32_t *cp) {
+  const uint8_t b0 = p[0];
+  const size_t avail = end - p;
+  if (b0 < 0xC2) {
+    return 0;  // a stray continuation byte, or an overlong two byte form
+  } else if (b0 < 0xE0) {
+    if (avail < 2 || !IsContinuation(p[1])) {
+      return 0;
+    }
+    *cp = ((b0 & 0x1F) << 6) | (p[1] & 0x3F);
+    return 2;
+  } else if (b0 < 0xF0) {
+    if (avail < 3 || !IsContinuation(p[1]) || !IsContinuation(p[2])) {
+      return 0;
+    }
+    if ((b0 == 0xE0 && p[1] < 0xA0) ||  // overlong
+        (b0 == 0xED && p[1] >= 0xA0)) {  // UTF-16 surrogate
+      return 0;
+    }
+    *cp = ((b0 & 0x0F) << 12) | ((p[1] & 0x3F) << 6) | (p[2] & 0x3F);
+    return 3;
+  } else if (b0 < 0xF5) {
+    if (avail < 4 || !IsContinuation(p[1]) || !IsContinuation(p[2]) ||
+        !IsContinuation(p[3])) {
+      return 0;
+    }
+    if ((b0 == 0xF0 && p[1] < 0x90) ||  // overlong
+        (b0 == 0xF4 && p[1] >= 0x90)) {  // past U+10FFFF
+      return 0;
+    }
+    *cp = ((b0 & 0x07) << 18) | ((p[1] & 0x3F) << 12) |
+        ((p[2] & 0x3F) << 6) | (p[3] & 0x3F);
+    return 4;
+  }
+  return 0;
+}
+
+// Returns the length of the run of ASCII bytes at the start of [p, end).
+inline size_t AsciiPrefix(const uint8_t *p, const uint8_t *end) {
+  const uint8_t *start = p;
+#ifdef __SSE2__
+  while (end - p >= 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    int mask = _mm_movemask_epi8(chunk);
+    if (mask != 0) {
+      return p - start + __builtin_ctz(mask);
+    }
+    p += 16;
+  }
+#endif
+  while (p < end && *p < 0x80) {
+    p++;
+  }
+  return p - start;
+}
+
+// Widens the run of ASCII bytes at the start of [p, end) into out, and returns
+// the length of the run.
+inline size_t WidenAscii(const uint8_t *p, const uint8_t *end, uint16_t *out) {
+  const uint8_t *start = p;
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  while (end - p >= 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    if (_mm_movemask_epi8(chunk) != 0) {
+      break;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out),
+                     _mm_unpacklo_epi8(chunk, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 8),
+                     _mm_unpackhi_epi8(chunk, zero));
+    p += 16;
+    out += 16;
+  }
+#endif
+  while (p < end && *p < 0x80) {
+    *out++ = *p++;
+  }
+  return p - start;
+}
+
+// Narrows the run of ASCII characters at the start of [p, end) into out, and
+// returns the length of the run.
+inline size_t NarrowAscii(const uint16_t *p, const uint16_t *end, char *out) {
+  const uint16_t *start = p;
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i high_bits = _mm_set1_epi16(static_cast<int16_t>(0xFF80));
+  while (end - p >= 8) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i high = _mm_cmpeq_epi16(_mm_and_si128(chunk, high_bits), zero);
+    if (_mm_movemask_epi8(high) != 0xFFFF) {
+      break;
+    }
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(out),
+                     _mm_packus_epi16(chunk, chunk));
+    p += 8;
+    out += 8;
+  }
+#endif
+  while (p < end && *p < 0x80) {
+    *out++ = static_cast<char>(*p++);
+  }
+  return p - start;
+}
+
+inline bool IsLeadSurrogate(uint16_t c) {
+  return c >= 0xD800 && c < 0xDC00;
+}
+
+inline bool IsTrailSurrogate(uint16_t c) {
+  return c >= 0xDC00 && c < 0xE000;
+}
+}
+
+namespace e {
+bool IsValidUtf8(const char *data, size_t length) {
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+  const uint8_t *end = p + length;
+  while (p < end) {
+    p += AsciiPrefix(p, end);
+    if (p == end) {
+      break;
+    }
+    uint32_t cp;
+    size_t used = DecodeSequence(p, end, &cp);
+    if (used == 0) {
+      return false;
+    }
+    p += used;
+  }
+  return true;
+}
+
+bool Utf8ToUtf16(const char *data, size_t length, std::vector<uint16_t> *out) {
+  // UTF-8 never needs fewer bytes than UTF-16 needs code units, so the input
+  // length is an upper bound on the output length.
+  const size_t base = out->size();
+  out->resize(base + length);
+  uint16_t *o = out->data() + base;
+
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+  const uint8_t *end = p + length;
+  while (p < end) {
+    size_t n = WidenAscii(p, end, o);
+    p += n;
+    o += n;
+    if (p == end) {
+      break;
+    }
+    uint32_t cp;
+    size_t used = DecodeSequence(p, end, &cp);
+    if (used == 0) {
+      out->resize(base);
+      return false;
+    }
+    p += used;
+    if (cp >= 0x10000) {
+      cp -= 0x10000;
+      *o++ = static_cast<uint16_t>(0xD800 | (cp >> 10));
+      *o++ = static_cast<uint16_t>(0xDC00 | (cp & 0x3FF));
+    } else {
+      *o++ = static_cast<uint16_t>(cp);
+    }
+  }
+  out->resize(o - out->data());
+  return true;
+}
+
+size_t Utf8Length(const uint16_t *data, size_t length) {
+  size_t total = 0;
+  const uint16_t *end = data + length;
+  for (const uint16_t *p = data; p < end; p++) {
+    if (*p < 0x80) {
+      total += 1;
+    } else if (*p < 0x800) {
+      total += 2;
+    } else if (IsLeadSurrogate(*p) && p + 1 < end && IsTrailSurrogate(p[1])) {
+      total += 4;
+      p++;
+    } else {
+      total += 3;
+    }
+  }
+  return total;
+}
+
+void Utf16ToUtf8(const uint16_t *data, size_t length, std::string *out) {
+  // Each UTF-16 code unit takes at most three bytes (a surrogate pair takes
+  // four bytes for two units).
+  const size_t base = out->size();
+  out->resize(base + length * 3);
+  char *start = &(*out)[0];
+  char *o = start + base;
+
+  const uint16_t *p = data;
+  const uint16_t *end = data + length;
+  while (p < end) {
+    size_t n = NarrowAscii(p, end, o);
+    p += n;
+    o += n;
+    if (p == end) {
+      break;
+    }
+    uint32_t c = *p++;
+    if (c < 0x800) {
+      *o++ = static_cast<char>(0xC0 | (c >> 6));
+      *o++ = static_cast<char>(0x80 | (c & 0x3F));
+    } else if (IsLeadSurrogate(c) && p < end && IsTrailSurrogate(*p)) {
+      c = 0x10000 + ((c - 0xD800) << 10) + (*p++ - 0xDC00);
+      *o++ = static_cast<char>(0xF0 | (c >> 18));
+      *o++ = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+      *o++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+      *o++ = static_cast<char>(0x80 | (c & 0x3F));
+    } else {
+      if (IsLeadSurrogate(c) || IsTrailSurrogate(c)) {
+        c = 0xFFFD;  // unpaired surrogate
+      }
+      *o++ = static_cast<char>(0xE0 | (c >> 12));
+      *o++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+      *o++ = static_cast<char>(0x80 | (c & 0x3F));
+    }
+  }
+  out->resize(o - start);
+}
+}
@@ -0,0 +1,37 @@
+// -*- C++ -*-
+// Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+//
+// Conversion between UTF-8 (the encoding used on disk) and UTF-16 (the
+// encoding used for lines and by V8). None of these routines touch V8, so they
+// are safe to call without a HandleScope and from any thread.
+//
+// The hot loops have an SSE2 fast path that handles runs of ASCII sixteen
+// bytes (or eight characters) at a time; everything else is decoded one
+// sequence at a time.
+
+#ifndef SRC_UTF8_H_
+#define SRC_UTF8_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace e {
+// Check that the input is well formed UTF-8 (no overlong forms, surrogates, or
+// code points past U+10FFFF).
+bool IsValidUtf8(const char *data, size_t length);
+
+// Decode UTF-8 into UTF-16, appending the result to out. Returns false (and
+// leaves out in an unspecified state) if the input isn't valid UTF-8.
+bool Utf8ToUtf16(const char *data, size_t length, std::vector<uint16_t> *out);
+
+// The number of bytes needed to encode the UTF-16 input as UTF-8.
+size_t Utf8Length(const uint16_t *data, size_t length);
+
+// Encode UTF-16 as UTF-8, appending the result to out. Unpaired surrogates
+// are written as U+FFFD.
+void Utf16ToUtf8(const uint16_t *data, size_t length, std::string *out);
+}
+
+#endif  // SRC_UTF8_H_
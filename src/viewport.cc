@@ -0,0 +1,458 @@
+// Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+
+#include "./viewport.h"
+
+#include <v8.h>
+
+#ifdef USE_NCURSESW
+#ifdef PLATFORM_LINUX
+#ifndef _XOPEN_SOURCE_EXTENDED
+#define _XOPEN_SOURCE_EXTENDED
+#endif  // _X_OPEN_SOURCE_EXTENDED
+#include <ncursesw/curses.h>
+#else
+#include <curses.h>
+#endif  // PLATFORM_LINUX
+#else  // USE_NCURSESW
+#include <curses.h>  // NOLINT
+#endif  // USE_NCURSESW
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <string>
+
+#include "./assert.h"
+#include "./embeddable.h"
+#include "./js.h"
+#include "./wcwidth.h"
+
+using v8::AccessorInfo;
+using v8::Arguments;
+using v8::External;
+using v8::Handle;
+using v8::HandleScope;
+using v8::Integer;
+using v8::Local;
+using v8::Object;
+using v8::ObjectTemplate;
+using v8::String;
+using v8::Undefined;
+using v8::Value;
+
+namespace {
+#ifdef USE_NCURSESW
+typedef std::wstring RowText;
+
+inline void AppendCodePoint(RowText *text, uint32_t c) {
+  text->push_back(static_cast<wchar_t>(c));
+}
+
+inline int AddRowText(WINDOW *win, const RowText &text) {
+  return waddnwstr(win, text.data(), text.size());
+}
+#else
+typedef std::string RowText;
+
+// Without wide character support only ASCII can be drawn, so everything else
+// is drawn as question marks.
+inline void AppendCodePoint(RowText *text, uint32_t c) {
+  if (c < 0x80) {
+    text->push_back(static_cast<char>(c));
+  } else {
+    text->append(e::CharWidth(c), '?');
+  }
+}
+
+inline int AddRowText(WINDOW *win, const RowText &text) {
+  return waddnstr(win, text.data(), text.size());
+}
+#endif  // USE_NCURSESW
+}
+
+namespace e {
+Viewport::Viewport(Buffer *buffer, JSCursesWindow *window,
+                   Handle<Object> window_object)
+    :buffer_(buffer), window_(window),
+     window_object_(Persistent<Object>::New(window_object)), top_(0),
+     left_(0), tilde_attrs_(0), frame_rows_(0), last_frame_rows_(0) {
+  buffer_->AddObserver(this);
+  Damage(0, getmaxy(window_->window_) - 1);
+}
+
+Viewport::~Viewport() {
+  if (buffer_ != nullptr) {
+    buffer_->RemoveObserver(this);
+  }
+  window_object_.Dispose();
+}
+
+void Viewport::SetTop(size_t top) {
+  if (top > top_) {
+    const size_t delta = top - top_;
+    top_ = top;
+    ShiftRows(0, -static_cast<int>(std::min<size_t>(delta, INT_MAX)));
+  } else if (top < top_) {
+    const size_t delta = top_ - top;
+    top_ = top;
+    ShiftRows(0, static_cast<int>(std::min<size_t>(delta, INT_MAX)));
+  }
+}
+
+void Viewport::SetLeft(size_t left) {
+  if (left != left_) {
+    left_ = left;
+    Damage(0, getmaxy(window_->window_) - 1);
+  }
+}
+
+int Viewport::Draw() {
+  return Draw(0, getmaxy(window_->window_) - 1);
+}
+
+int Viewport::Draw(int first, int last) {
+  WINDOW *win = window_->window_;
+  int maxy, maxx, cury, curx;
+  getmaxyx(win, maxy, maxx);
+  getyx(win, cury, curx);
+  first = std::max(first, 0);
+  last = std::min(last, maxy - 1);
+  if (buffer_ == nullptr || first > last) {
+    return 0;
+  }
+
+  // writing to the bottom right corner would scroll the window
+  const bool scroll = is_scrollok(win);
+  scrollok(win, false);
+  const bool tracked = damaged_.size() == static_cast<size_t>(maxy);
+  for (int row = first; row <= last; row++) {
+    DrawRow(row, maxx);
+    if (tracked) {
+      damaged_[row] = false;
+    }
+  }
+  scrollok(win, scroll);
+  wmove(win, cury, curx);
+
+  const int rows = last - first + 1;
+  frame_rows_ += rows;
+  return rows;
+}
+
+void Viewport::Damage(int first, int last) {
+  const int maxy = getmaxy(window_->window_);
+  if (damaged_.size() != static_cast<size_t>(maxy)) {
+    damaged_.assign(maxy, true);  // the window was resized
+    return;
+  }
+  first = std::max(first, 0);
+  last = std::min(last, maxy - 1);
+  for (int row = first; row <= last; row++) {
+    damaged_[row] = true;
+  }
+}
+
+void Viewport::DamageLines(size_t first, size_t last) {
+  if (last < top_) {
+    return;
+  }
+  const size_t rows = static_cast<size_t>(getmaxy(window_->window_));
+  first = std::max(first, top_) - top_;
+  last = last - top_;
+  if (first < rows) {
+    Damage(static_cast<int>(first), static_cast<int>(std::min(last, rows - 1)));
+  }
+}
+
+int Viewport::Repaint() {
+  const int maxy = getmaxy(window_->window_);
+  if (damaged_.size() != static_cast<size_t>(maxy)) {
+    damaged_.assign(maxy, true);
+  }
+  // draw each run of damaged rows
+  int row = 0;
+  while (row < maxy) {
+    if (!damaged_[row]) {
+      row++;
+      continue;
+    }
+    int last = row;
+    while (last + 1 < maxy && damaged_[last + 1]) {
+      last++;
+    }
+    Draw(row, last);
+    row = last + 1;
+  }
+
+  last_frame_rows_ = frame_rows_;
+  frame_rows_ = 0;
+  return last_frame_rows_;
+}
+
+// Move rows first through the bottom of the window down by count rows (or up,
+// if count is negative), along with their damage bits, and damage the rows
+// that are exposed. This uses wscrl() or winsdelln() so that curses can use
+// the terminal's own scrolling rather than redrawing the moved rows.
+void Viewport::ShiftRows(int first, int count) {
+  WINDOW *win = window_->window_;
+  const int maxy = getmaxy(win);
+  if (damaged_.size() != static_cast<size_t>(maxy)) {
+    damaged_.assign(maxy, true);
+    return;
+  }
+  if (first < 0 || first >= maxy || count == 0) {
+    return;
+  }
+  if (std::abs(count) >= maxy - first ||
+      std::find(damaged_.begin() + first, damaged_.end(), false) ==
+      damaged_.end()) {
+    Damage(first, maxy - 1);  // nothing on the screen is worth keeping
+    return;
+  }
+
+  int cury, curx;
+  getyx(win, cury, curx);
+  if (first == 0) {
+    const bool scroll = is_scrollok(win);
+    scrollok(win, true);
+    wsetscrreg(win, 0, maxy - 1);
+    wscrl(win, -count);
+    scrollok(win, scroll);
+  } else {
+    wmove(win, first, 0);
+    winsdelln(win, count);
+  }
+  wmove(win, cury, curx);
+
+  if (count > 0) {
+    std::copy_backward(damaged_.begin() + first, damaged_.end() - count,
+                       damaged_.end());
+    Damage(first, first + count - 1);
+  } else {
+    std::copy(damaged_.begin() + first - count, damaged_.end(),
+              damaged_.begin() + first);
+    Damage(maxy + count, maxy - 1);
+  }
+}
+
+// Inserting or erasing lines shifts the lines below them; if the change is
+// above the top of the window the line numbers of everything in the window
+// change, so it all has to be redrawn.
+void Viewport::LinesInserted(size_t first, size_t count) {
+  if (first < top_) {
+    Damage(0, getmaxy(window_->window_) - 1);
+  } else if (first - top_ < static_cast<size_t>(getmaxy(window_->window_))) {
+    ShiftRows(static_cast<int>(first - top_),
+              static_cast<int>(std::min<size_t>(count, INT_MAX)));
+  }
+}
+
+void Viewport::LinesErased(size_t first, size_t count) {
+  if (first < top_) {
+    Damage(0, getmaxy(window_->window_) - 1);
+  } else if (first - top_ < static_cast<size_t>(getmaxy(window_->window_))) {
+    ShiftRows(static_cast<int>(first - top_),
+              -static_cast<int>(std::min<size_t>(count, INT_MAX)));
+  }
+}
+
+void Viewport::LinesModified(size_t first, size_t count) {
+  DamageLines(first, first + count - 1);
+}
+
+void Viewport::BufferDeleted() {
+  buffer_ = nullptr;
+}
+
+void Viewport::DrawRow(int row, int width) {
+  WINDOW *win = window_->window_;
+  wmove(win, row, 0);
+
+  const size_t lineno = top_ + static_cast<size_t>(row);
+  if (lineno >= buffer_->Size()) {
+    wattron(win, tilde_attrs_);
+    waddnstr(win, "~", 1);
+    wattroff(win, tilde_attrs_);
+    wclrtoeol(win);
+    return;
+  }
+
+  const Line *line = (*buffer_)[lineno];
+  const uint16_t *chars = line->Data();
+  const size_t size = line->Size();
+  const size_t right = left_ + static_cast<size_t>(width);
+
+  // reused from row to row, so drawing doesn't allocate
+  static RowText text;
+  text.clear();
+  size_t i = line->IndexAt(left_);
+  size_t column = line->ColumnOf(i);
+  while (i < size && column < right) {
+    uint32_t c = chars[i++];
+    if (c >= 0xD800 && c < 0xDC00 && i < size &&
+        chars[i] >= 0xDC00 && chars[i] < 0xE000) {
+      c = 0x10000 + ((c - 0xD800) << 10) + (chars[i++] - 0xDC00);
+    }
+    const size_t next = line->ColumnOf(i);
+    const size_t w = next - column;
+    if (c == '\t' || column < left_ || column + w > right) {
+      // tabs, and characters cut off by the edges of the window, are drawn as
+      // spaces
+      size_t visible = std::min(column + w, right) - std::max(column, left_);
+      text.append(visible, ' ');
+    } else if (c < 0x20 || c == 0x7F) {
+      AppendCodePoint(&text, '^');
+      AppendCodePoint(&text, c ^ 0x40);
+    } else {
+      AppendCodePoint(&text, c);
+    }
+    column = next;
+  }
+  AddRowText(win, text);
+
+  // if the row was filled the cursor has already wrapped to the next row
+  if (column < right) {
+    wclrtoeol(win);
+  }
+}
+
+namespace {
+// @class: Viewport
+// @description: Draws part of a buffer into a window (see
+//               `Buffer.createViewport()`).
+//
+// @method: draw
+// @param[first]: #int the first row to draw (optional)
+// @param[last]: #int the last row to draw (optional)
+// @description: Draws the rows of the window from `first` to `last`
+//               (inclusive), or the whole window, and returns the number of
+//               rows drawn. The cursor isn't moved.
+Handle<Value> JSDraw(const Arguments& args) {
+  GET_SELF(Viewport);
+  HandleScope scope;
+  int rows;
+  if (args.Length() >= 2) {
+    rows = self->Draw(args[0]->Int32Value(), args[1]->Int32Value());
+  } else {
+    rows = self->Draw();
+  }
+  return scope.Close(Integer::New(rows));
+}
+
+// @method: damage
+// @param[first]: #int the first row to redraw
+// @param[last]: #int the last row to redraw
+// @description: Marks rows of the window as needing to be redrawn by the next
+//               `repaint()`. Changes to the buffer, `top` and `left` do this
+//               automatically.
+Handle<Value> JSDamage(const Arguments& args) {
+  CHECK_ARGS(2);
+  GET_SELF(Viewport);
+  self->Damage(args[0]->Int32Value(), args[1]->Int32Value());
+  return scope.Close(Undefined());
+}
+
+// @method: repaint
+// @description: Draws the rows of the window that are out of date, and
+//               returns the number of rows drawn. This should be called once
+//               per screen update, before `curses.doupdate()`.
+Handle<Value> JSRepaint(const Arguments& args) {
+  GET_SELF(Viewport);
+  HandleScope scope;
+  return scope.Close(Integer::New(self->Repaint()));
+}
+
+// @accessor: left
+// @description: The screen column shown in the first column of the window.
+Handle<Value> JSGetLeft(Local<String> property, const AccessorInfo& info) {
+  HandleScope scope;
+  ACCESSOR_GET_SELF(Viewport);
+  return scope.Close(Integer::New(self->Left()));
+}
+
+void JSSetLeft(Local<String> property, Local<Value> value,
+               const AccessorInfo& info) {
+  ACCESSOR_GET_SELF(Viewport);
+  self->SetLeft(static_cast<size_t>(value->Uint32Value()));
+}
+
+// @accessor: rowsPainted
+// @description: The number of rows drawn in the last frame (i.e. up to the
+//               last `repaint()`); useful for checking how much drawing
+//               damage tracking saves.
+Handle<Value> JSGetRowsPainted(Local<String> property,
+                               const AccessorInfo& info) {
+  HandleScope scope;
+  ACCESSOR_GET_SELF(Viewport);
+  return scope.Close(Integer::New(self->RowsPainted()));
+}
+
+// @accessor: tildeAttrs
+// @description: The attributes (e.g. a color pair) used to draw the tildes
+//               shown past the end of the buffer.
+Handle<Value> JSGetTildeAttrs(Local<String> property,
+                              const AccessorInfo& info) {
+  HandleScope scope;
+  ACCESSOR_GET_SELF(Viewport);
+  return scope.Close(Integer::New(self->TildeAttrs()));
+}
+
+void JSSetTildeAttrs(Local<String> property, Local<Value> value,
+                     const AccessorInfo& info) {
+  ACCESSOR_GET_SELF(Viewport);
+  self->SetTildeAttrs(value->Int32Value());
+}
+
+// @accessor: top
+// @description: The line of the buffer shown on the first row of the window.
+Handle<Value> JSGetTop(Local<String> property, const AccessorInfo& info) {
+  HandleScope scope;
+  ACCESSOR_GET_SELF(Viewport);
+  return scope.Close(Integer::New(self->Top()));
+}
+
+void JSSetTop(Local<String> property, Local<Value> value,
+              const AccessorInfo& info) {
+  ACCESSOR_GET_SELF(Viewport);
+  self->SetTop(static_cast<size_t>(value->Uint32Value()));
+}
+
+Persistent<ObjectTemplate> viewport_template;
+
+Handle<ObjectTemplate> MakeViewportTemplate() {
+  HandleScope scope;
+  Handle<ObjectTemplate> result = ObjectTemplate::New();
+  result->SetInternalFieldCount(1);
+  js::AddTemplateFunction(result, "damage", JSDamage);
+  js::AddTemplateFunction(result, "draw", JSDraw);
+  js::AddTemplateAccessor(result, "left", JSGetLeft, JSSetLeft);
+  js::AddTemplateFunction(result, "repaint", JSRepaint);
+  js::AddTemplateAccessor(result, "rowsPainted", JSGetRowsPainted, nullptr);
+  js::AddTemplateAccessor(result, "tildeAttrs", JSGetTildeAttrs,
+                          JSSetTildeAttrs);
+  js::AddTemplateAccessor(result, "top", JSGetTop, JSSetTop);
+  return scope.Close(result);
+}
+}
+
+Handle<Value> Viewport::ToScript() {
+  HandleScope scope;
+  ASSERT(handle_.IsEmpty());
+  if (viewport_template.IsEmpty()) {
+    Handle<ObjectTemplate> raw_template = MakeViewportTemplate();
+    viewport_template = Persistent<ObjectTemplate>::New(raw_template);
+  }
+  Local<Object> obj = viewport_template->NewInstance();
+  obj->SetInternalField(0, External::New(this));
+  handle_ = Persistent<Object>::New(obj);
+  handle_.MakeWeak(this, &Viewport::OnCollected);
+  return scope.Close(obj);
+}
+
+void Viewport::OnCollected(Persistent<Value> val, void *param) {
+  Viewport *self = static_cast<Viewport *>(param);
+  val.Dispose();
+  self->handle_.Clear();
+  delete self;
+}
+}
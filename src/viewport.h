@@ -0,0 +1,103 @@
+// -*- C++ -*-
+// Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+//
+// A viewport draws part of a buffer into a curses window. The viewport knows
+// which line of the buffer is at the top of the window and how far the window
+// is scrolled horizontally; scripts configure it and ask it to redraw, and all
+// of the drawing (including the tildes past the end of the buffer) happens
+// natively.
+//
+// The viewport observes its buffer, and keeps track of which rows of the
+// window are out of date ("damaged") so that Repaint() only has to draw those
+// rows. Scrolling and inserting or erasing lines move the rows already on the
+// screen (so curses can use the terminal's scrolling and insert/delete line
+// capabilities), and only the rows that are exposed need to be redrawn.
+
+#ifndef SRC_VIEWPORT_H_
+#define SRC_VIEWPORT_H_
+
+#include <v8.h>
+
+#include <string>
+#include <vector>
+
+#include "./buffer.h"
+#include "./js_curses_window.h"
+
+using v8::Handle;
+using v8::Object;
+using v8::Persistent;
+using v8::Value;
+
+namespace e {
+class Viewport : public BufferObserver {
+ public:
+  // A viewport drawing into window, whose script object (window_object) is
+  // kept alive for as long as the viewport is
+  Viewport(Buffer *buffer, JSCursesWindow *window,
+           Handle<Object> window_object);
+  ~Viewport();
+
+  // The line of the buffer shown on the first row of the window
+  inline size_t Top() const { return top_; }
+  void SetTop(size_t top);
+
+  // The screen column shown in the first column of the window
+  inline size_t Left() const { return left_; }
+  void SetLeft(size_t left);
+
+  // The attributes used to draw the tildes past the end of the buffer
+  inline int TildeAttrs() const { return tilde_attrs_; }
+  inline void SetTildeAttrs(int attrs) { tilde_attrs_ = attrs; }
+
+  // Draw rows first through last (inclusive) of the window, clamped to the
+  // size of the window. The cursor is left where it was. Returns the number of
+  // rows drawn.
+  int Draw(int first, int last);
+
+  // Draw every row of the window
+  int Draw();
+
+  // Mark rows first through last (inclusive) as needing to be redrawn
+  void Damage(int first, int last);
+
+  // Draw the damaged rows, and end the frame. Returns the number of rows
+  // drawn.
+  int Repaint();
+
+  // The number of rows drawn in the last frame (i.e. by Draw() and Repaint()
+  // since the Repaint() before that), for debugging.
+  inline int RowsPainted() const { return last_frame_rows_; }
+
+  // BufferObserver implementation
+  virtual void LinesInserted(size_t first, size_t count);
+  virtual void LinesErased(size_t first, size_t count);
+  virtual void LinesModified(size_t first, size_t count);
+  virtual void BufferDeleted();
+
+  // Get the script object for a new viewport. The viewport is owned by the
+  // script object, and is deleted when it's garbage collected.
+  Handle<Value> ToScript();
+
+ private:
+  Buffer *buffer_;
+  JSCursesWindow *window_;
+  Persistent<Object> window_object_;
+  size_t top_;
+  size_t left_;
+  int tilde_attrs_;
+  Persistent<Object> handle_;
+
+  std::vector<bool> damaged_;  // one entry per row of the window
+  int frame_rows_;
+  int last_frame_rows_;
+
+  void DrawRow(int row, int width);
+  void DamageLines(size_t first, size_t last);
+  void ShiftRows(int first, int count);
+
+  static void OnCollected(Persistent<Value>, void *);
+};
+}
+
+#endif  // SRC_VIEWPORT_H_
@@ -0,0 +1,158 @@
+// Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+
+#include "./watchdog.h"
+
+#include <v8.h>
+#include <v8-debug.h>
+
+#include <chrono>
+#include <string>
+
+#include "./latency.h"
+#include "./logging.h"
+
+using v8::HandleScope;
+using v8::Local;
+using v8::StackFrame;
+using v8::StackTrace;
+using v8::String;
+
+namespace e {
+Watchdog *watchdog = nullptr;
+
+namespace {
+const uint64_t kNanosPerMilli = 1000000;
+
+// Called by V8 on the main thread; breaks are only requested by the watchdog
+// thread, when a script has gone over its soft budget.
+void OnDebugEvent(v8::DebugEvent event,
+                  v8::Handle<v8::Object> exec_state,
+                  v8::Handle<v8::Object> event_data,
+                  v8::Handle<v8::Value> data) {
+  if (event != v8::Break) {
+    return;
+  }
+  HandleScope scope;
+  Local<StackTrace> trace = StackTrace::CurrentStackTrace(
+      16, StackTrace::kOverview);
+  LOG(WARNING, "slow script stack trace:");
+  for (int i = 0; i < trace->GetFrameCount(); i++) {
+    Local<StackFrame> frame = trace->GetFrame(i);
+    String::Utf8Value function_name(frame->GetFunctionName());
+    String::Utf8Value script_name(frame->GetScriptName());
+    LOG(WARNING, "    %s() at %s:%d",
+        function_name.length() ? *function_name : "<anonymous>",
+        *script_name, frame->GetLineNumber());
+  }
+}
+}
+
+Watchdog::Watchdog(int soft_millis, int hard_millis)
+    :depth_(0), armed_(false), start_(0), soft_fired_(false),
+     terminated_(false), idle_(false), stop_(false) {
+  default_budget_.soft = soft_millis * kNanosPerMilli;
+  default_budget_.hard = hard_millis * kNanosPerMilli;
+  if (soft_millis > 0) {
+    v8::Debug::SetDebugEventListener(OnDebugEvent);
+  }
+  thread_ = std::thread(&Watchdog::Run, this);
+}
+
+Watchdog::~Watchdog() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_one();
+  thread_.join();
+}
+
+void Watchdog::SetBudget(const std::string &type, int soft_millis,
+                         int hard_millis) {
+  Budget &budget = budgets_[type];
+  budget.soft = soft_millis * kNanosPerMilli;
+  budget.hard = hard_millis * kNanosPerMilli;
+  if (soft_millis > 0) {
+    v8::Debug::SetDebugEventListener(OnDebugEvent);
+  }
+}
+
+void Watchdog::Arm(const std::string &type) {
+  if (depth_++ > 0) {
+    return;
+  }
+  auto it = budgets_.find(type);
+  const Budget &budget = it == budgets_.end() ? default_budget_ : it->second;
+  std::lock_guard<std::mutex> lock(mutex_);
+  armed_ = true;
+  type_ = type;
+  start_ = MonotonicNanos();
+  budget_ = budget;
+  soft_fired_ = false;
+  terminated_ = false;
+  if (idle_) {
+    cond_.notify_one();
+  }
+}
+
+void Watchdog::Disarm() {
+  if (--depth_ > 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  armed_ = false;
+  if (soft_fired_) {
+    // the break may not have happened yet, if the script was running native
+    // code when it went over the budget
+    v8::Debug::CancelDebugBreak();
+    LOG(WARNING, "%s handler took %d ms", type_.c_str(),
+        static_cast<int>((MonotonicNanos() - start_) / kNanosPerMilli));
+  }
+}
+
+bool Watchdog::Terminated() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return terminated_;
+}
+
+// The watchdog thread only wakes up when it's armed while idle, and when the
+// next budget of the script it was armed for is due. Scripts are usually much
+// faster than their budgets, so by then the watchdog has normally been armed
+// for another script (or disarmed), and the thread goes back to sleep until
+// that script's budget is due.
+void Watchdog::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    // the next budget due is the soft one, unless it's already been exceeded
+    // (or is unlimited), and then the hard one
+    const bool soft = !soft_fired_ && budget_.soft != 0;
+    const uint64_t budget = soft ? budget_.soft : budget_.hard;
+    if (!armed_ || terminated_ || budget == 0) {
+      idle_ = true;
+      cond_.wait(lock);
+      idle_ = false;
+      continue;
+    }
+    const uint64_t now = MonotonicNanos();
+    if (now < start_ + budget) {
+      cond_.wait_for(lock, std::chrono::nanoseconds(start_ + budget - now));
+      continue;
+    }
+
+    if (soft) {
+      soft_fired_ = true;
+      LOG(WARNING, "%s handler has run for over %d ms", type_.c_str(),
+          static_cast<int>(budget / kNanosPerMilli));
+      v8::Debug::DebugBreak();
+    } else {
+      // If the script returns before the termination takes effect, the next
+      // script run is terminated instead; that's the best that can be done
+      // with the V8 API.
+      terminated_ = true;
+      LOG(ERROR, "terminating %s handler after %d ms", type_.c_str(),
+          static_cast<int>(budget / kNanosPerMilli));
+      v8::V8::TerminateExecution();
+    }
+  }
+}
+}
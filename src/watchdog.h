@@ -0,0 +1,95 @@
+// -*- C++ -*-
+// Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+//
+// A watchdog for scripts. Everything the editor does runs on one thread, so a
+// keypress handler stuck in a loop would otherwise freeze it forever.
+//
+// The watchdog is armed whenever scripts are run (an event being dispatched, a
+// timer firing, or a script being loaded), and disarmed when they return. It
+// has its own thread that sleeps until the running script goes over its
+// budget. There are two budgets: past the soft budget, the JavaScript stack is
+// logged (by breaking into V8's debugger, since the stack can only be read
+// from the thread running the script), and past the hard budget the script is
+// terminated with V8::TerminateExecution(), which unwinds it back to the main
+// loop. The budgets can be set for each event type; timers are the "timer"
+// type, and loading a script is the "script" type.
+
+#ifndef SRC_WATCHDOG_H_
+#define SRC_WATCHDOG_H_
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace e {
+class Watchdog {
+ public:
+  // Start the watchdog thread, with default budgets (in milliseconds) for
+  // event types that don't have their own; a budget of 0 is unlimited.
+  Watchdog(int soft_millis, int hard_millis);
+
+  // Stop the watchdog thread
+  ~Watchdog();
+
+  // Set the budgets (in milliseconds) for an event type
+  void SetBudget(const std::string &type, int soft_millis, int hard_millis);
+
+  // Start timing scripts run for an event type. Calls can be nested; only the
+  // outermost one is timed.
+  void Arm(const std::string &type);
+  void Disarm();
+
+  // Was the last script timed terminated for going over the hard budget?
+  bool Terminated();
+
+ private:
+  struct Budget {
+    uint64_t soft;  // in nanoseconds
+    uint64_t hard;
+  };
+
+  Budget default_budget_;
+  std::map<std::string, Budget> budgets_;
+  int depth_;  // how deeply Arm() calls are nested (main thread only)
+
+  // shared by both threads, and guarded by mutex_
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool armed_;
+  std::string type_;
+  uint64_t start_;
+  Budget budget_;
+  bool soft_fired_;
+  bool terminated_;
+  bool idle_;  // true while the thread is waiting to be armed
+  bool stop_;
+
+  std::thread thread_;
+
+  void Run();
+};
+
+// The watchdog, unless both budgets were 0 (otherwise null)
+extern Watchdog *watchdog;
+
+// Arms the watchdog (if there is one) for as long as it's in scope
+class WatchdogScope {
+ public:
+  explicit WatchdogScope(const std::string &type) {
+    if (watchdog != nullptr) {
+      watchdog->Arm(type);
+    }
+  }
+  ~WatchdogScope() {
+    if (watchdog != nullptr) {
+      watchdog->Disarm();
+    }
+  }
+};
+}
+
+#endif  // SRC_WATCHDOG_H_
@@ -0,0 +1,22 @@
+// -*- C++ -*-
+// Copyright 2012, Evan Klitzke <evan@eklitzke.org>
+//
+// A wcwidth(3) style table of the number of terminal columns each character
+// occupies. Unlike wcwidth(3) this doesn't depend on the current locale, so
+// column calculations are the same everywhere.
+
+#ifndef SRC_WCWIDTH_H_
+#define SRC_WCWIDTH_H_
+
+#include <stdint.h>
+
+namespace e {
+// Returns the number of columns used to display a code point: 0 for combining
+// and other zero width characters, 2 for East Asian wide and fullwidth
+// characters, and 1 for everything else. Control characters are displayed in
+// caret notation (e.g. ^A), so they're two columns wide. Tabs aren't handled
+// here, since their width depends on their position.
+int CharWidth(uint32_t code_point);
+}
+
+#endif  // SRC_WCWIDTH_H_
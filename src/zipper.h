@@ -51,6 +51,10 @@ class Zipper {
   // the zipper contents
   void ToBuffer(T buffer[], bool refocus) const;
 
+  // Get a pointer to the contents as one contiguous array. This flattens the
+  // zipper, so the pointer is only valid until the next mutating operation.
+  const T* Data() const;
+
   T operator[](size_t offset) const;
 
  private:
@@ -67,9 +71,7 @@ class Zipper {
 template <typename T>
 void Zipper<T>::Insert(size_t position, const T vals[], size_t num_elems) {
   Refocus(position);
-  for (size_t i = 0; i < num_elems; i++) {
-    front_.push_back(vals[i]);
-  }
+  front_.insert(front_.end(), vals, vals + num_elems);
 }
 
 template <typename T>
@@ -101,12 +103,18 @@ void Zipper<T>::ToBuffer(T buffer[], bool refocus) const {
   if (!back_.empty()) {
     std::vector<T> back_copy = back_;
     std::reverse(back_copy.begin(), back_copy.end());
-    memcpy(static_cast<void *>(buffer),
+    memcpy(static_cast<void *>(buffer + front_.size()),
            static_cast<const void *>(back_copy.data()),
            back_copy.size() * sizeof(T));
   }
 }
 
+template <typename T>
+const T* Zipper<T>::Data() const {
+  Flatten();
+  return front_.data();
+}
+
 template <typename T>
 void Zipper<T>::Refocus(const size_t position) {
   ASSERT(position <= Size());